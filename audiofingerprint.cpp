@@ -0,0 +1,129 @@
+#include "audiofingerprint.h"
+#include "video.h"
+
+QVector<uint32_t> AudioFingerprint::extract(const QString &filename, const int64_t &duration)
+{
+    const int64_t start = qMax(static_cast<int64_t>(0), duration / 2 - _windowSec * 1000 / 2);
+    QProcess ffmpeg;
+    const QString ffmpegCommand = QStringLiteral("ffmpeg -hide_banner -loglevel error -ss %1 -t %2 -i \"%3\" "
+                                                 "-vn -ac 1 -ar %4 -f s16le -")
+                                  .arg(start / 1000.0, 0, 'f', 3).arg(_windowSec)
+                                  .arg(QDir::toNativeSeparators(filename)).arg(_sampleRate);
+    ffmpeg.start(ffmpegCommand);
+    if(!ffmpeg.waitForFinished(_timeout))
+    {
+        ffmpeg.kill();
+        ffmpeg.waitForFinished();
+        return QVector<uint32_t>();
+    }
+
+    const QByteArray raw = ffmpeg.readAllStandardOutput();
+    QVector<int16_t> pcm(raw.size() / static_cast<int>(sizeof(int16_t)));
+    memcpy(pcm.data(), raw.constData(), static_cast<size_t>(pcm.count()) * sizeof(int16_t));
+    return compute(pcm);
+}
+
+QVector<uint32_t> AudioFingerprint::compute(const QVector<int16_t> &pcm)
+{
+    const int frames = (pcm.count() - _frameSize) / _hopSize + 1;
+    if(frames < _targetFrames)
+        return QVector<uint32_t>();
+
+    static const int bandEdges[_bands + 1] = { 4, 12, 24, 48, 96, 160, 256 };   //FFT bins, roughly logarithmic
+    cv::Mat hann;
+    cv::createHanningWindow(hann, cv::Size(_frameSize, 1), CV_32F);
+
+    QVector<QPair<int, int>> peaks;                     //(frame, bin) of loudest bin per band, if it stands out
+    float bandAverage[_bands] = { 0, 0, 0, 0, 0, 0 };
+    cv::Mat frame(1, _frameSize, CV_32F), spectrum, planes[2], magnitude;
+    for(int f=0; f<frames; f++)
+    {
+        const int16_t *samples = pcm.constData() + f * _hopSize;
+        float *data = frame.ptr<float>(0);
+        for(int i=0; i<_frameSize; i++)
+            data[i] = samples[i] * hann.at<float>(0, i);
+        cv::dft(frame, spectrum, cv::DFT_COMPLEX_OUTPUT);
+        cv::split(spectrum, planes);
+        cv::magnitude(planes[0], planes[1], magnitude);
+        const float *bins = magnitude.ptr<float>(0);
+
+        for(int band=0; band<_bands; band++)
+        {
+            int loudest = bandEdges[band];
+            for(int bin=bandEdges[band]+1; bin<bandEdges[band+1]; bin++)
+                if(bins[bin] > bins[loudest])
+                    loudest = bin;
+            if(bins[loudest] > 2 * bandAverage[band] && bins[loudest] > 1000)     //skip quiet and flat frames
+                peaks << qMakePair(f, loudest);
+            bandAverage[band] = 0.9f * bandAverage[band] + 0.1f * bins[loudest];  //adapts to loudness changes
+        }
+    }
+
+    QVector<uint32_t> hashes;
+    for(int anchor=0; anchor<peaks.count(); anchor++)
+    {
+        int paired = 0;
+        for(int target=anchor+1; target<peaks.count() && paired<_fanOut; target++)
+        {
+            const int timeDelta = peaks[target].first - peaks[anchor].first;
+            if(timeDelta == 0)
+                continue;
+            if(timeDelta >= _targetFrames)
+                break;
+            hashes << (static_cast<uint32_t>(peaks[anchor].second) << 15 |       //9 bits frequency of anchor
+                       static_cast<uint32_t>(peaks[target].second) << 6 |        //9 bits frequency of target
+                       static_cast<uint32_t>(timeDelta));                        //6 bits time difference
+            paired++;
+        }
+    }
+
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    return hashes;
+}
+
+AudioIndex::AudioIndex(const QVector<Video *> &videos) : _videos(videos)
+{
+    for(int video=0; video<_videos.count(); video++)
+        if(hasFingerprint(video))
+            for(const auto hash : _videos[video]->audioHashes)
+                _postings[hash] << video;
+
+    for(auto posting=_postings.begin(); posting!=_postings.end(); )
+        if(posting.value().count() > _maxPostingSize)
+            posting = _postings.erase(posting);
+        else
+            posting++;
+}
+
+bool AudioIndex::hasFingerprint(const int &index) const
+{
+    return _videos[index]->audioHashes.count() >= _minHashes;
+}
+
+QHash<int, double> AudioIndex::candidates(const int &index) const
+{
+    QHash<int, double> result;
+    if(!hasFingerprint(index))
+        return result;
+
+    QHash<int, int> shared;
+    for(const auto hash : _videos[index]->audioHashes)
+    {
+        const auto posting = _postings.constFind(hash);
+        if(posting == _postings.cend())
+            continue;
+        for(const int other : posting.value())
+            if(other > index)
+                shared[other]++;
+    }
+
+    for(auto count=shared.cbegin(); count!=shared.cend(); count++)
+    {
+        const int smaller = qMin(_videos[index]->audioHashes.count(), _videos[count.key()]->audioHashes.count());
+        const double ratio = static_cast<double>(count.value()) / smaller;
+        if(count.value() >= _minShared && ratio >= _minRatio)
+            result[count.key()] = ratio;
+    }
+    return result;
+}
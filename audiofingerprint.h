@@ -0,0 +1,49 @@
+#ifndef AUDIOFINGERPRINT_H
+#define AUDIOFINGERPRINT_H
+
+#include <QHash>
+#include <QVector>
+
+class Video;
+
+class AudioFingerprint
+{
+public:
+    //decode a short mono window from middle of video with ffmpeg, return sorted unique spectral peak pair hashes
+    static QVector<uint32_t> extract(const QString &filename, const int64_t &duration);
+
+    //hashes of (frequency, frequency, time difference) for pairs of spectrogram peaks, like chromaprint/shazam
+    static QVector<uint32_t> compute(const QVector<int16_t> &pcm);
+
+private:
+    static constexpr int _sampleRate   = 8000;      //speech and music fundamentals are all below 4 kHz
+    static constexpr int _windowSec    = 30;        //seconds of audio decoded from each video
+    static constexpr int _frameSize    = 512;       //64 ms FFT frames
+    static constexpr int _hopSize      = 256;       //50% overlap
+    static constexpr int _bands        = 6;         //one peak per band per frame at most
+    static constexpr int _fanOut       = 3;         //each peak is paired with this many following peaks
+    static constexpr int _targetFrames = 32;        //how far ahead following peaks are searched
+    static constexpr int _timeout      = 30000;
+};
+
+class AudioIndex
+{
+public:
+    explicit AudioIndex(const QVector<Video *> &videos);
+
+    //videos with larger index than video[index] sharing audio hashes, value is shared / smaller hash count
+    QHash<int, double> candidates(const int &index) const;
+
+    bool hasFingerprint(const int &index) const;
+
+private:
+    const QVector<Video *> &_videos;
+    QHash<uint32_t, QVector<int>> _postings;        //hash -> indexes of videos containing it
+
+    static constexpr int _minHashes      = 50;      //silence or very short audio gives too few peaks to trust
+    static constexpr int _minShared      = 10;
+    static constexpr double _minRatio    = 0.05;    //candidates share at least this much of smaller fingerprint
+    static constexpr int _maxPostingSize = 1000;    //hashes found in very many videos (jingles, silence) are noise
+};
+
+#endif // AUDIOFINGERPRINT_H
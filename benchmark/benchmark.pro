@@ -0,0 +1,62 @@
+TARGET = benchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+QT += core gui widgets sql
+
+QMAKE_CXXFLAGS_RELEASE -= -O
+QMAKE_CXXFLAGS_RELEASE -= -O1
+QMAKE_CXXFLAGS_RELEASE -= -O2
+QMAKE_CXXFLAGS_RELEASE *= -O3
+QMAKE_CXXFLAGS += -fopenmp
+QMAKE_CXXFLAGS_RELEASE += -fopenmp
+QMAKE_LFLAGS += -fopenmp
+QMAKE_LFLAGS_RELEASE += -fopenmp
+
+INCLUDEPATH += ..
+
+HEADERS += \
+    ../prefs.h \
+    ../video.h \
+    ../thumbnail.h \
+    ../db.h \
+    ../temporal.h \
+    ../audiofingerprint.h \
+    ../hashindex.h \
+    ../scoring.h \
+    ../tiles.h \
+    ../metrics.h \
+    ../capturecodec.h \
+    ingest.h
+
+SOURCES += \
+    main.cpp \
+    ingest.cpp \
+    ../video.cpp \
+    ../db.cpp \
+    ../ssim.cpp \
+    ../temporal.cpp \
+    ../audiofingerprint.cpp \
+    ../hashindex.cpp \
+    ../scoring.cpp \
+    ../tiles.cpp \
+    ../metrics.cpp \
+    ../capturecodec.cpp
+
+LIBS += \
+    $$PWD/../bin64/libopencv_core348.dll \
+    $$PWD/../bin64/libopencv_imgproc348.dll\
+    $$PWD/../bin64/libopencv_video348.dll\
+    $$PWD/../bin64/libopencv_videoio348.dll
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
+
+#Throughput of comparison kernels on synthetic fingerprints, no videos or ffmpeg needed:
+    #benchmark --videos 100000                   pHash mode, one hash per video
+    #benchmark --videos 1000000 --pairs 0        indexed search only, needs about 4 GB of memory
+    #benchmark --ssim --cutends --threshold 50   slowest mode, SSIM of 16 hashes per video
+    #benchmark --ingest --sources 50           generates 300 clips once, then times cold and warm cache
+    #benchmark --ingest --captures gray        same with gray raw captures, compare decode stage of warm run
+    #Build in release mode, timings of a debug build say nothing about the kernels
@@ -0,0 +1,226 @@
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QFileInfo>
+#include <QDir>
+#include <QTemporaryDir>
+#include <QSet>
+#include "ingest.h"
+#include "../video.h"
+#include "../scoring.h"
+#include "../hashindex.h"
+#include "../thumbnail.h"
+#include "../metrics.h"
+
+namespace
+{
+    struct Variant
+    {
+        const char *name;
+        const char *arguments;          //ffmpeg arguments between input and output file
+    };
+
+    //known duplicates of every source clip, all made from its "original"
+    const Variant variants[] = {
+        { "reencode",    "-c:v libx264 -crf 38 -preset veryfast" },
+        { "scaled",      "-vf scale=320:180 -c:v libx264 -crf 23 -preset veryfast" },
+        { "cropped",     "-vf crop=iw*9/10:ih*9/10 -c:v libx264 -crf 23 -preset veryfast" },
+        { "letterboxed", "-vf scale=640:270,pad=640:360:0:45 -c:v libx264 -crf 23 -preset veryfast" },
+        { "trimmed",     "-ss 1 -t 18 -c:v libx264 -crf 23 -preset veryfast" }
+    };
+
+    //regions of mandelbrot set that look different from each other, cycled with different zoom and hue
+    const double regions[][2] = {
+        { -0.743643887, 0.131825904 }, { -0.7453, 0.1127 }, { -1.25066, 0.02012 }, { -0.16, 1.0405 },
+        { -0.925, 0.266 }, { -1.7497591, 0.0 }, { 0.2549870, 0.0005 }, { -0.0452407, 0.9868162 }
+    };
+
+    class ProcessTask : public QRunnable
+    {
+    public:
+        ProcessTask(Video *video, char &accepted) : _video(video), _accepted(accepted) { }
+        void run() override { _accepted = _video->process(); }
+
+    private:
+        Video *_video;
+        char &_accepted;
+    };
+
+    bool ffmpeg(const QString &arguments, const int &timeout)
+    {
+        QProcess process;
+        process.start(QStringLiteral("ffmpeg -y -hide_banner -loglevel error %1").arg(arguments));
+        if(!process.waitForFinished(timeout))
+        {
+            process.kill();
+            process.waitForFinished();
+            return false;
+        }
+        return process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+    }
+
+    QTextStream out(stdout);
+}
+
+IngestBenchmark::IngestBenchmark(const Prefs &prefs, const QString &corpusFolder, const int &sources) :
+    _prefs(prefs), _corpusFolder(corpusFolder), _sources(sources)
+{
+    _prefs._minSizeBytes = 0;               //generated clips are short and small
+    _prefs._minTimeMs = 0;
+}
+
+bool IngestBenchmark::run()
+{
+    if(!generateCorpus())
+    {
+        out << QStringLiteral("Could not generate test clips, is ffmpeg in PATH?\n");
+        return false;
+    }
+    const QStringList files = corpusFiles();
+    out << QStringLiteral("%1 clips from %2 sources in %3\n")
+           .arg(files.count()).arg(_sources).arg(QDir::toNativeSeparators(_corpusFolder));
+
+    const QTemporaryDir cacheFolder;                //cold run starts with empty cache, cache.db of program is not touched
+    if(!cacheFolder.isValid())
+    {
+        out << QStringLiteral("Could not create temporary folder for cache\n");
+        return false;
+    }
+    Db::setCacheFile(cacheFolder.filePath(QStringLiteral("cache.db")));
+    runOnce(QStringLiteral("cold cache"), files);
+    runOnce(QStringLiteral("warm cache"), files);
+    return true;
+}
+
+bool IngestBenchmark::generateCorpus() const
+{
+    QDir().mkpath(_corpusFolder);
+    const int regionCount = sizeof(regions) / sizeof(regions[0]);
+    for(int source=0; source<_sources; source++)    //clips that already exist are reused, so runs are comparable
+    {
+        const QString prefix = QStringLiteral("%1/src%2_").arg(_corpusFolder).arg(source, 3, 10, QChar('0'));
+        const QString original = QStringLiteral("%1original.mp4").arg(prefix);
+        if(!QFileInfo::exists(original))
+        {
+            out << QStringLiteral("Generating source %1/%2\n").arg(source + 1).arg(_sources);
+            out.flush();
+            const QString mandelbrot = QStringLiteral("mandelbrot=s=%1x%2:rate=25:start_x=%3:start_y=%4:"
+                                                      "start_scale=%5:end_scale=0.001:end_pts=%6")
+                                       .arg(_width).arg(_height)
+                                       .arg(regions[source % regionCount][0], 0, 'g', 10)
+                                       .arg(regions[source % regionCount][1], 0, 'g', 10)
+                                       .arg(0.5 + source / regionCount % 4).arg(_clipSeconds);
+            if(!ffmpeg(QStringLiteral("-f lavfi -i \"%1\" -t %2 -vf hue=h=%3 -c:v libx264 -crf 20 -preset veryfast "
+                                      "-pix_fmt yuv420p \"%4\"")
+                       .arg(mandelbrot).arg(_clipSeconds).arg(source * 47 % 360).arg(original), _timeout))
+                return false;
+        }
+
+        for(const auto &variant : variants)
+        {
+            const QString duplicate = QStringLiteral("%1%2.mp4").arg(prefix, variant.name);
+            if(!QFileInfo::exists(duplicate) &&
+               !ffmpeg(QStringLiteral("-i \"%1\" %2 \"%3\"").arg(original, variant.arguments, duplicate), _timeout))
+                return false;
+        }
+    }
+    return true;
+}
+
+QStringList IngestBenchmark::corpusFiles() const
+{
+    QStringList files;
+    const QStringList names = QDir(_corpusFolder).entryList(QStringList() << QStringLiteral("src*.mp4"), QDir::Files, QDir::Name);
+    for(const auto &name : names)
+        if(sourceOf(name).mid(3).toInt() < _sources)            //folder may hold clips of a larger earlier run
+            files << QStringLiteral("%1/%2").arg(_corpusFolder, name);
+    return files;
+}
+
+QString IngestBenchmark::sourceOf(const QString &filename)
+{
+    return QFileInfo(filename).fileName().section('_', 0, 0);
+}
+
+void IngestBenchmark::runOnce(const QString &label, const QStringList &files) const
+{
+    Metrics::instance().reset(false);
+    QVector<Stage> stages;
+    QElapsedTimer timer, total;
+    total.start();
+    timer.start();
+
+    Prefs prefs = _prefs;
+    prefs._numberOfVideos = files.count();
+    Video::setPrefs(prefs);
+    VideoArena arena;
+    QMultiHash<QString, Video *> everyVideo;
+    QVector<Video *> videos;
+    for(const auto &file : files)
+    {
+        const QString id = Db::contentId(file);
+        Video *video = arena.create(file, QFileInfo(file).lastModified(), id);
+        everyVideo.insert(id, video);
+        videos << video;
+    }
+    stages << Stage{ QStringLiteral("content ids"), timer.restart() };
+
+    {
+        Db setup(QStringLiteral("benchmark"), nullptr);
+        setup.createTables();
+        setup.setCaptureFormat(prefs._captureFormat);
+        setup.populateMetadatas(everyVideo);
+        setup.populateCaptures(everyVideo, Thumbnail(prefs._thumbnails).percentages());
+        setup.populateCrops(everyVideo);
+        if(prefs._temporal)
+            setup.populateTemporals(everyVideo, prefs._temporalInterval);
+        if(prefs._audio)
+            setup.populateAudio(everyVideo);
+    }
+    stages << Stage{ QStringLiteral("cache lookup"), timer.restart() };
+
+    QVector<char> accepted(videos.count(), 0);
+    QThreadPool threadPool;
+    for(int i=0; i<videos.count(); i++)
+        threadPool.start(new ProcessTask(videos[i], accepted[i]));     //task is deleted by thread pool when done
+    threadPool.waitForDone();
+    stages << Stage{ QStringLiteral("process videos"), timer.restart() };
+
+    QVector<Video *> processed;
+    for(int i=0; i<videos.count(); i++)
+        if(accepted[i])
+            processed << videos[i];
+
+    const Scoring scoring(prefs);
+    const HashIndex hashIndex(processed, scoring.maxHashDistance());   //same as preprocessing of app
+    QSet<QPair<QString, QString>> found;
+    for(int i=0; i<processed.count(); i++)
+    {
+        QVector<int> candidates = hashIndex.candidates(i);
+        for(const int j : candidates)
+            if(scoring.score(processed[i], processed[j]).match)
+                found << qMakePair(processed[i]->filename, processed[j]->filename);
+    }
+    stages << Stage{ QStringLiteral("compare pairs"), timer.restart() };
+    stages << Stage{ QStringLiteral("total"), total.elapsed() };
+
+    int truePairs = 0;
+    QHash<QString, int> clipsOfSource;
+    for(const auto &file : files)
+        truePairs += clipsOfSource[sourceOf(file)]++;          //every clip pairs with each earlier clip of its source
+    int trueFound = 0;
+    for(const auto &pair : found)
+        if(sourceOf(pair.first) == sourceOf(pair.second))
+            trueFound++;
+
+    out << QStringLiteral("\n%1:\n").arg(label);
+    for(const auto &stage : stages)
+        out << QStringLiteral("  %1 %2 ms\n").arg(stage.name.leftJustified(16)).arg(stage.ms, 8);
+    out << QStringLiteral("  %1 of %2 videos accepted\n").arg(processed.count()).arg(videos.count());
+    out << QStringLiteral("  %1 pairs found, %2 true: precision %3%, recall %4%\n")
+           .arg(found.count()).arg(trueFound)
+           .arg(found.isEmpty()? 100.0 : 100.0 * trueFound / found.count(), 0, 'f', 1)
+           .arg(truePairs == 0? 100.0 : 100.0 * trueFound / truePairs, 0, 'f', 1);
+    out << Metrics::instance().summary().replace(QStringLiteral("\n"), QStringLiteral("\n  ")).prepend(QStringLiteral("  ")) << '\n';
+    out.flush();
+}
@@ -0,0 +1,40 @@
+#ifndef INGEST_H
+#define INGEST_H
+
+#include <QString>
+#include "../prefs.h"
+
+//end to end benchmark: generates short clips with ffmpeg lavfi (each source also re-encoded, scaled, cropped,
+//letterboxed and trimmed), runs them through cache population, Video::process() and pair scoring, first with
+//an empty cache and then with a full one, and reports timing of each stage and precision/recall of found pairs
+class IngestBenchmark
+{
+public:
+    IngestBenchmark(const Prefs &prefs, const QString &corpusFolder, const int &sources);
+
+    //returns false if corpus could not be generated (ffmpeg missing)
+    bool run();
+
+private:
+    struct Stage
+    {
+        QString name;
+        int64_t ms = 0;
+    };
+
+    Prefs _prefs;
+    QString _corpusFolder;
+    int _sources;
+
+    bool generateCorpus() const;
+    QStringList corpusFiles() const;
+    void runOnce(const QString &label, const QStringList &files) const;
+    static QString sourceOf(const QString &filename);
+
+    static constexpr int _clipSeconds = 20;
+    static constexpr int _width       = 640;
+    static constexpr int _height      = 360;
+    static constexpr int _timeout     = 120000;
+};
+
+#endif // INGEST_H
@@ -0,0 +1,225 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QDir>
+#include <random>
+#include <omp.h>
+#include "../video.h"
+#include "../scoring.h"
+#include "../temporal.h"
+#include "../hashindex.h"
+#include "../tiles.h"
+#include "../capturecodec.h"
+#include "ingest.h"
+
+//measures comparison kernels on synthetic fingerprints, so their speed can be compared before and after a change.
+//Every 10th video is a near copy of previous one (a few bits flipped), so matching code paths are also exercised
+
+static constexpr int _thumbnailSide  = 448;      //like a capture before it is hashed
+static constexpr int _maxPhashImages = 100000;
+static constexpr int _maxSsimPairs   = 1000000;
+static constexpr int _neighbours     = 64;       //hamming and similarity kernels: pairs per video
+
+static QTextStream out(stdout);
+static std::mt19937_64 randomBits(1);       //fixed seed: every run compares the same fingerprints
+static volatile int64_t sink;               //results are written here so compiler can't skip the work
+
+static void report(const QString &kernel, const int64_t &operations, const QElapsedTimer &timer)
+{
+    const double seconds = qMax(timer.nsecsElapsed(), static_cast<qint64>(1)) / 1e9;
+    out << kernel.leftJustified(28) << QStringLiteral("%1 ops in %2 ms").arg(operations, 12).arg(seconds * 1000, 10, 'f', 1)
+        << QStringLiteral("%1 Mops/s").arg(operations / seconds / 1e6, 12, 'f', 3) << '\n';
+    out.flush();
+}
+
+static uint64_t flipBits(uint64_t hash, const int &bits)
+{
+    for(int i=0; i<bits; i++)
+        hash ^= 1ULL << (randomBits() % 64);
+    return hash;
+}
+
+static void makeFingerprints(QVector<Video *> &videos, VideoArena &arena, const Prefs &prefs, const int &count)
+{
+    Video::setPrefs(prefs);
+    for(int i=0; i<count; i++)
+    {
+        Video *video = arena.create(QStringLiteral("synthetic%1").arg(i), QDateTime(), QString::number(i));
+        const Video *original = i % 10 == 9? videos.last() : nullptr;
+        video->duration = original? original->duration : static_cast<int64_t>(randomBits() % 7200000);
+        const int slots = video->hashCount();
+        QVector<uint64_t> hashes(slots);
+        QByteArray grayThumbs(slots * Video::_ssimBytes, '\0');
+        QVector<uint64_t> fineHashes(prefs._fineHash? slots * Video::_fineHashWords : 0);
+        for(int slot=0; slot<slots; slot++)
+        {
+            hashes[slot] = original? flipBits(original->hashAt(slot), 3) : randomBits();
+            for(int word=0; word<Video::_fineHashWords && !fineHashes.isEmpty(); word++)
+                fineHashes[slot * Video::_fineHashWords + word] =
+                    original? flipBits(original->fineHashAt(slot)[word], 3) : randomBits();
+            uint8_t *gray = reinterpret_cast<uint8_t *>(grayThumbs.data()) + slot * Video::_ssimBytes;
+            for(int pixel=0; pixel<Video::_ssimBytes; pixel++)
+                gray[pixel] = original?
+                    static_cast<uint8_t>(qBound(0, original->grayThumbAt(slot)[pixel] + static_cast<int>(randomBits() % 9) - 4, 255)) :
+                    static_cast<uint8_t>(randomBits());
+        }
+        video->setHashes(hashes, grayThumbs, fineHashes);
+        videos << video;
+    }
+}
+
+static void benchmarkPhash(const int &images)
+{
+    QVector<cv::Mat> captures;
+    for(int i=0; i<qMin(images, 256); i++)      //reused round robin, decoding is not what is measured
+    {
+        cv::Mat capture(_thumbnailSide, _thumbnailSide, CV_8UC3);
+        cv::randu(capture, cv::Scalar::all(0), cv::Scalar::all(255));
+        captures << capture;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    int64_t total = 0;
+    for(int i=0; i<images; i++)
+        total += static_cast<int64_t>(Video::computePhash(captures[i % captures.count()]) & 1);
+    sink = total;
+    report(QStringLiteral("Video::computePhash"), images, timer);
+
+    timer.start();
+    uint64_t fine[4];
+    for(int i=0; i<images; i++)
+    {
+        Video::computeFineHash(captures[i % captures.count()], fine);
+        total += static_cast<int64_t>(fine[0] & 1);
+    }
+    sink = total;
+    report(QStringLiteral("Video::computeFineHash"), images, timer);
+}
+
+static void benchmarkKernels(const QVector<Video *> &videos, const Prefs &prefs)
+{
+    const Scoring scoring(prefs);
+    const int count = videos.count();
+    QElapsedTimer timer;
+    int64_t total = 0;
+
+    timer.start();
+    for(int i=0; i<count; i++)
+        for(int j=1; j<=_neighbours; j++)
+            total += Temporal::hammingDistance(videos[i]->hashAt(0), videos[(i + j) % count]->hashAt(0));
+    sink = total;
+    report(QStringLiteral("Temporal::hammingDistance"), static_cast<int64_t>(count) * _neighbours, timer);
+
+    timer.start();
+    for(int i=0; i<count; i++)
+        for(int j=1; j<=_neighbours; j++)
+            total += scoring.phashSimilarity(videos[i], videos[(i + j) % count], 0, 0);
+    sink = total;
+    report(QStringLiteral("Scoring::phashSimilarity"), static_cast<int64_t>(count) * _neighbours, timer);
+
+    const int ssimPairs = qMin(count, _maxSsimPairs);
+    timer.start();
+    double similarity = 0;
+    for(int i=0; i<ssimPairs; i++)
+        similarity += Scoring::ssim(videos[i]->grayThumbAt(0), videos[(i + 1) % count]->grayThumbAt(0), prefs._ssimBlockSize);
+    sink = static_cast<int64_t>(similarity);
+    report(QStringLiteral("Scoring::ssim"), ssimPairs, timer);
+}
+
+static void benchmarkSearch(const QVector<Video *> &videos, const Prefs &prefs, const int64_t &maxPairs)
+{
+    const Scoring scoring(prefs);
+    std::atomic<int64_t> matches(0);
+    QElapsedTimer timer;
+
+    timer.start();
+    const HashIndex hashIndex(videos, scoring.maxHashDistance());      //same as preprocessing of app
+    int64_t candidates = 0;
+    if(hashIndex.indexed())
+    {
+        #pragma omp parallel for schedule(dynamic) reduction(+:candidates)
+        for(int i = 0; i < videos.size(); i++)
+            for(const int j : hashIndex.candidates(i))
+            {
+                candidates++;
+                if(scoring.score(videos[i], videos[j]).match)
+                    matches++;
+            }
+        report(QStringLiteral("indexed search (candidates)"), candidates, timer);
+    }
+    else
+        out << QStringLiteral("indexed search skipped: threshold too low for hash index\n");
+
+    int bruteForceVideos = videos.count();      //all pairs grows quadratically, compare only first videos
+    while(static_cast<int64_t>(bruteForceVideos) * (bruteForceVideos - 1) / 2 > maxPairs)
+        bruteForceVideos = bruteForceVideos * 9 / 10;
+    const QVector<Video *> firstVideos = videos.mid(0, bruteForceVideos);
+    const int64_t pairs = static_cast<int64_t>(bruteForceVideos) * (bruteForceVideos - 1) / 2;
+
+    timer.start();
+    TileScheduler tiles(firstVideos.size());
+    #pragma omp parallel
+    {
+        Tile tile;
+        while(tiles.next(tile))
+            for(int i = tile.rowStart; i < tile.rowEnd; i++)
+                for(int j = qMax(i + 1, tile.columnStart); j < tile.columnEnd; j++)
+                    if(scoring.score(firstVideos[i], firstVideos[j]).match)
+                        matches++;
+    }
+    report(QStringLiteral("tiled all pairs (%1 videos)").arg(bruteForceVideos), pairs, timer);
+    sink = matches;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Throughput of Vidupe comparison kernels on synthetic fingerprints"));
+    parser.addHelpOption();
+    const QCommandLineOption videosOption(QStringList() << "n" << "videos", "Number of synthetic videos.", "count", "10000");
+    const QCommandLineOption pairsOption("pairs", "Most pairs compared by tiled all pairs search.", "count", "50000000");
+    const QCommandLineOption ssimOption("ssim", "Score pairs with SSIM instead of pHash.");
+    const QCommandLineOption cutEndsOption("cutends", "16 hashes per video (cutEnds thumbnail mode) instead of one.");
+    const QCommandLineOption fineOption("fine", "pHash matches must also match by 256 bit fine hashes.");
+    const QCommandLineOption thresholdOption("threshold", "pHash threshold, same bits of 64.", "bits", "57");
+    const QCommandLineOption ingestOption("ingest", "End to end benchmark on generated clips instead (needs ffmpeg), "
+                                          "with a temporary cache.");
+    const QCommandLineOption corpusOption("corpus", "Folder of generated clips, reused between runs.", "folder",
+                                          QDir::temp().filePath(QStringLiteral("vidupe-corpus")));
+    const QCommandLineOption sourcesOption("sources", "Number of source clips, each gets 5 known duplicates.", "count", "20");
+    const QCommandLineOption capturesOption("captures", "With --ingest: cache captures as jpeg, gray or color.", "format", "jpeg");
+    parser.addOptions({ videosOption, pairsOption, ssimOption, cutEndsOption, fineOption, thresholdOption,
+                        ingestOption, corpusOption, sourcesOption, capturesOption });
+    parser.process(app);
+
+    Prefs prefs;
+    prefs._comparisonMode = parser.isSet(ssimOption)? prefs._SSIM : prefs._PHASH;
+    prefs._thumbnails = parser.isSet(cutEndsOption)? cutEnds : thumb12;
+    prefs._fineHash = parser.isSet(fineOption);
+    prefs._thresholdPhash = parser.value(thresholdOption).toInt();
+    prefs._captureFormat = qMax(CaptureCodec::fromName(parser.value(capturesOption)), 0);
+    const int count = qMax(2, parser.value(videosOption).toInt());
+
+    if(parser.isSet(ingestOption))
+    {
+        IngestBenchmark ingest(prefs, parser.value(corpusOption), qMax(1, parser.value(sourcesOption).toInt()));
+        return ingest.run()? 0 : 1;
+    }
+
+    out << QStringLiteral("%1 videos, %2 mode, %3 hash(es) per video, %4 threads")
+           .arg(count).arg(parser.isSet(ssimOption)? "SSIM" : "pHash")
+           .arg(parser.isSet(cutEndsOption)? 16 : 1).arg(omp_get_max_threads()) << '\n';
+
+    VideoArena arena;                           //about 1 kB per video, a million synthetic videos need 1 GB
+    QVector<Video *> videos;
+    videos.reserve(count);
+    makeFingerprints(videos, arena, prefs, count);
+
+    benchmarkPhash(qMin(count, _maxPhashImages));
+    benchmarkKernels(videos, prefs);
+    benchmarkSearch(videos, prefs, parser.value(pairsOption).toLongLong());
+    return 0;
+}
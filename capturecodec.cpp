@@ -0,0 +1,88 @@
+#include <QBuffer>
+#include <QtEndian>
+#include <cstring>
+#include "capturecodec.h"
+
+QByteArray CaptureCodec::encode(const QImage &image, const int &format)
+{
+    QByteArray data;
+    if(format != gray && format != color)
+    {
+        QBuffer buffer(&data);
+        image.save(&buffer, QByteArrayLiteral("JPG"), _jpegQuality);
+        return data;
+    }
+
+    QImage small = image;
+    if(small.width() > _rawMaxWidth || small.height() > _rawMaxHeight)
+        small = small.scaled(_rawMaxWidth, _rawMaxHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    small = small.convertToFormat(QImage::Format_RGB888);
+
+    const int channels = format == gray? 1 : 3;
+    QByteArray pixels(small.width() * small.height() * channels, Qt::Uninitialized);
+    uchar *out = reinterpret_cast<uchar *>(pixels.data());
+    for(int y=0; y<small.height(); y++)             //rows of QImage are padded, stored ones are not
+    {
+        const uchar *line = small.constScanLine(y);
+        if(format == color)
+        {
+            memcpy(out, line, static_cast<size_t>(small.width()) * 3);
+            out += small.width() * 3;
+            continue;
+        }
+        for(int x=0; x<small.width(); x++, line+=3)     //same weights as OpenCV, so hashes match those of JPEG captures
+            *out++ = static_cast<uchar>((299 * line[0] + 587 * line[1] + 114 * line[2] + 500) / 1000);
+    }
+
+    char header[_headerSize] = { 'V', 'C', static_cast<char>(format), 0 };
+    qToLittleEndian<quint16>(static_cast<quint16>(small.width()), header + 4);
+    qToLittleEndian<quint16>(static_cast<quint16>(small.height()), header + 6);
+    data.append(header, _headerSize);
+    data.append(qCompress(pixels, _zlibLevel));
+    return data;
+}
+
+QImage CaptureCodec::decode(const QByteArray &data)
+{
+    const int format = formatOf(data);
+    if(format == jpeg)
+        return QImage::fromData(data, "JPG");
+
+    const int width = qFromLittleEndian<quint16>(data.constData() + 4);
+    const int height = qFromLittleEndian<quint16>(data.constData() + 6);
+    const int channels = format == gray? 1 : 3;
+    const QByteArray pixels = qUncompress(reinterpret_cast<const uchar *>(data.constData()) + _headerSize,
+                                          data.size() - _headerSize);
+    if(width == 0 || height == 0 || pixels.size() != width * height * channels)
+        return QImage();
+
+    QImage image(width, height, format == gray? QImage::Format_Grayscale8 : QImage::Format_RGB888);
+    for(int y=0; y<height; y++)
+        memcpy(image.scanLine(y), pixels.constData() + y * width * channels, static_cast<size_t>(width) * channels);
+    return image;
+}
+
+int CaptureCodec::formatOf(const QByteArray &data)
+{
+    if(data.size() < _headerSize || data[0] != 'V' || data[1] != 'C' || data[2] <= jpeg || data[2] >= formatCount)
+        return jpeg;                                //JPEG starts with 0xFF 0xD8
+    return data[2];
+}
+
+QString CaptureCodec::name(const int &format)
+{
+    switch(format)
+    {
+    case gray: return QStringLiteral("gray");
+    case color: return QStringLiteral("color");
+    default: return QStringLiteral("jpeg");
+    }
+}
+
+int CaptureCodec::fromName(const QString &name)
+{
+    for(int format=jpeg; format<formatCount; format++)
+        if(name.compare(CaptureCodec::name(format), Qt::CaseInsensitive) == 0)
+            return format;
+    return -1;
+}
@@ -0,0 +1,33 @@
+#ifndef CAPTURECODEC_H
+#define CAPTURECODEC_H
+
+#include <QImage>
+
+//how screen captures are stored in cache, chosen per cache. JPEG keeps full thumbnail size, the raw formats
+//are scaled down to fixed small size and zlib compressed: much faster to decode, gray is enough for hashing
+//(thumbnails of comparison window are then gray too). Raw blobs start with a small header, so a cache being
+//converted may hold both kinds and older caches (JPEG only) are read as they are
+class CaptureCodec
+{
+public:
+    enum Format { jpeg, gray, color, formatCount };
+
+    static QByteArray encode(const QImage &image, const int &format);
+
+    //null image if data is damaged
+    static QImage decode(const QByteArray &data);
+
+    static int formatOf(const QByteArray &data);
+
+    static QString name(const int &format);
+    static int fromName(const QString &name);       //-1 if there is no such format
+
+private:
+    static constexpr int _jpegQuality   = 60;
+    static constexpr int _rawMaxWidth   = 224;      //half of GUI thumbnail, hashes are made of 32x32 anyway
+    static constexpr int _rawMaxHeight  = 168;
+    static constexpr int _headerSize    = 8;        //'V' 'C' format 0 width height (16 bit little endian)
+    static constexpr int _zlibLevel     = 1;        //higher levels barely make gray captures smaller
+};
+
+#endif // CAPTURECODEC_H
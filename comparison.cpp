@@ -1,11 +1,15 @@
 #include <QMessageBox>
 #include <QWheelEvent>
+#include <QtConcurrent/QtConcurrent>
+#include <atomic>
 #include "comparison.h"
 #include "ui_comparison.h"
+#include "metrics.h"
 #include <omp.h>
 
 Comparison::Comparison(const QVector<Video *> &videosParam, const Prefs &prefsParam) :
-    QDialog(prefsParam._mainwPtr, Qt::Window), _videos(videosParam), _prefs(prefsParam)
+    QDialog(prefsParam._mainwPtr, Qt::Window), _videos(videosParam), _prefs(prefsParam),
+    _scoring(_prefs), _prefetcher(_thumbnailCacheSize)
 {
     ui = new Ui::Comparison;
     ui->setupUi(this);
@@ -20,6 +24,8 @@ Comparison::Comparison(const QVector<Video *> &videosParam, const Prefs &prefsPa
     ui->thresholdSlider->setValue(QVariant(_prefs._thresholdSSIM * 100).toInt());
     ui->thresholdSliderMax->setValue(QVariant(_prefs._thresholdSSIMMax * 100).toInt());
     ui->progressBar->setMaximum(100);
+    _zoomPool.setMaxThreadCount(_zoomThreads);
+    connect(&_prefetcher, SIGNAL(thumbnailLoaded()), this, SLOT(showThumbnails()));
 
     on_preprocessVideo_clicked();
     on_nextVideo_clicked();
@@ -104,7 +110,7 @@ void Comparison::on_prevVideo_clicked()
             }
 
             const QPair<Video *, Video *> pair = _preprocessedVideos[_vectorIndex];
-            if(QFileInfo::exists(pair.first->filename) && QFileInfo::exists(pair.second->filename)){
+            if(bothVideosExist(pair.first, pair.second)){
                 showVideo(QStringLiteral("left"));
                 showVideo(QStringLiteral("right"));
                 highlightBetterProperties();
@@ -116,6 +122,7 @@ void Comparison::on_prevVideo_clicked()
                 }
                 updateUI();
                 ui->progressBar->setValue(comparisonsSoFar());
+                prefetchNearbyPairs();
                 return;
             }
         }
@@ -127,14 +134,19 @@ void Comparison::on_prevVideo_clicked()
     for(_rightVideo--, left=begin+_leftVideo; left>=begin; left--, _leftVideo--)
     {
         for(right=begin+_rightVideo; right>left; right--, _rightVideo--)
-            if(bothVideosMatch(*left, *right) && QFileInfo::exists((*left)->filename) && QFileInfo::exists((*right)->filename))
+        {
+            const double similarity = bothVideosMatch(*left, *right);
+            if(similarity && bothVideosExist(*left, *right))
             {
+                _phashSimilarity = static_cast<int>(similarity);
+                _ssimSimilarity = similarity;
                 showVideo(QStringLiteral("left"));
                 showVideo(QStringLiteral("right"));
                 highlightBetterProperties();
                 updateUI();
                 return;
             }
+        }
         ui->progressBar->setValue(comparisonsSoFar());
         _rightVideo = _prefs._numberOfVideos - 1;
     }
@@ -160,7 +172,7 @@ void Comparison::on_nextVideo_clicked()
             emit sendStatusMessage(QString("%1 preproccessed index").arg(_vectorIndex));
 
             const QPair<Video *, Video *> pair = _preprocessedVideos[_vectorIndex];
-            if(QFileInfo::exists(pair.first->filename) && QFileInfo::exists(pair.second->filename)){
+            if(bothVideosExist(pair.first, pair.second)){
                 showVideo(QStringLiteral("left"));
                 showVideo(QStringLiteral("right"));
                 highlightBetterProperties();
@@ -172,7 +184,7 @@ void Comparison::on_nextVideo_clicked()
                 }
                 updateUI();
                 ui->progressBar->setValue(comparisonsSoFar());
-
+                prefetchNearbyPairs();
                 return;
             } else {
                 emit sendStatusMessage(QString("file %1 not exist").arg(pair.first->filename));
@@ -187,14 +199,19 @@ void Comparison::on_nextVideo_clicked()
     for(left=begin+_leftVideo; left<end; left++, _leftVideo++)
     {
         for(_rightVideo++, right=begin+_rightVideo; right<end; right++, _rightVideo++)
-            if(bothVideosMatch(*left, *right) && QFileInfo::exists((*left)->filename) && QFileInfo::exists((*right)->filename))
+        {
+            const double similarity = bothVideosMatch(*left, *right);
+            if(similarity && bothVideosExist(*left, *right))
             {
+                _phashSimilarity = static_cast<int>(similarity);
+                _ssimSimilarity = similarity;
                 showVideo(QStringLiteral("left"));
                 showVideo(QStringLiteral("right"));
                 highlightBetterProperties();
                 updateUI();
                 return;
             }
+        }
         ui->progressBar->setValue(comparisonsSoFar());
         _rightVideo = _leftVideo + 1;
     }
@@ -206,41 +223,159 @@ void Comparison::on_nextVideo_clicked()
 
 void Comparison::on_preprocessVideo_clicked()
 {
+    const ScopedTimer timer("compare");
     _seekForwards = true;
     _preprocessedVideos.clear();
     _similarityMap.clear();
 
-    //QVector<Video*>::const_iterator left, right, begin = _videos.cbegin(), end = _videos.cend() - 1;
+    struct PairMatch { int left; int right; double similarity; };
+    const int threads = omp_get_max_threads();
+    QVector<QVector<PairMatch>> captureMatches(threads);    //every thread collects into its own vector, no locking
+    QVector<QVector<PairMatch>> audioMatches(threads);      //same soundtrack but captures differ (e.g. recoloured copy)
+    QVector<QVector<PairMatch>> temporalMatches(threads);
 
-    //QVector<QPair<Video *, Video *>> vec_private;
-    #pragma omp parallel for
-    for(int i = 0; i < _videos.size(); i++)
+    auto addMatches = [this](const QVector<QVector<PairMatch>> &perThread)
     {
-        for(int j=i+1; j < _videos.size(); j++)
+        QVector<PairMatch> matches;
+        for(const auto &threadMatches : perThread)
+            matches << threadMatches;
+        std::sort(matches.begin(), matches.end(), [](const PairMatch &a, const PairMatch &b)
+            { return a.left < b.left || (a.left == b.left && a.right < b.right); });  //same order on every run
+        for(const auto &match : matches)
         {
-            const double similarity = bothVideosMatch(_videos.at(i), _videos.at(j));
-            if(similarity)
+            const QPair<Video *, Video *> _pair(_videos.at(match.left), _videos.at(match.right));
+            if(!_similarityMap.contains(_pair))
             {
-                #pragma omp critical
-                {
-                    QPair<Video *, Video *> _pair = QPair<Video *, Video *>();
-                    _pair.first = _videos.at(i);
-                    _pair.second = _videos.at(j);
-                    //_preprocessedVideos.append(_pair);
-                    _preprocessedVideos.push_back(_pair);
-                    if(_prefs._comparisonMode == _prefs._PHASH)
-                        _similarityMap[_pair] = similarity;
-                    if(_prefs._comparisonMode == _prefs._SSIM)
-                        _similarityMap[_pair] = similarity;
-                }
+                _preprocessedVideos.push_back(_pair);
+                _similarityMap[_pair] = match.similarity;
             }
         }
+    };
+
+    QScopedPointer<AudioIndex> audioIndex(_prefs._audio? new AudioIndex(_videos) : nullptr);
+    QVector<QHash<int, double>> audioCandidates(_videos.size());     //videos sharing audio, by index of other video
+    if(audioIndex)
+    {
+        #pragma omp parallel for schedule(dynamic)
+        for(int i = 0; i < _videos.size(); i++)
+            audioCandidates[i] = audioIndex->candidates(i);
     }
 
-    emit sendStatusMessage(QString("Preprocessed %1 matches").arg(_preprocessedVideos.length()));
+    auto comparePair = [&](const int &thread, const int &i, const int &j)
+    {
+        if(audioIndex && _prefs._audioPrefilter && audioIndex->hasFingerprint(i) && audioIndex->hasFingerprint(j) &&
+           !audioCandidates[i].contains(j))
+            return;                                 //both have audio and it differs, skip comparing captures
+        const double similarity = bothVideosMatch(_videos.at(i), _videos.at(j), false);
+        if(similarity)
+            captureMatches[thread] << PairMatch{ i, j, similarity };
+        else if(audioCandidates[i].value(j) >= _prefs._audioMatchRatio)     //shown similarity is that of captures
+            audioMatches[thread] << PairMatch{ i, j, _prefs._comparisonMode == _prefs._PHASH?
+                    _scoring.phashSimilarity(_videos.at(i), _videos.at(j), 0, 0) :
+                    Scoring::ssim(_videos.at(i)->grayThumbAt(0), _videos.at(j)->grayThumbAt(0), _prefs._ssimBlockSize) };
+    };
+
+    const HashIndex hashIndex(_videos, _scoring.maxHashDistance());      //cutEnds: only pairs with a close tile pair
+    std::atomic<int64_t> pairsDone(0);
+    std::atomic<int64_t> pairsCompared(0);
+
+    if(hashIndex.indexed())
+    {
+        #pragma omp parallel for schedule(dynamic)
+        for(int i = 0; i < _videos.size(); i++)
+        {
+            const int thread = omp_get_thread_num();
+            QVector<int> candidates = hashIndex.candidates(i);
+            const int indexed = candidates.count();     //sorted part, appended audio candidates are not
+            for(auto audio=audioCandidates[i].cbegin(); audio!=audioCandidates[i].cend(); audio++)
+                if(audio.value() >= _prefs._audioMatchRatio &&
+                   !std::binary_search(candidates.cbegin(), candidates.cbegin() + indexed, audio.key()))
+                    candidates << audio.key();      //captures differ too much for index, but may still be audio match
+            for(const int j : candidates)
+                comparePair(thread, i, j);
+
+            pairsCompared += candidates.count();
+            pairsDone += _videos.size() - 1 - i;
+            if(thread == 0)                     //only gui thread may touch widgets
+                showPreprocessProgress(pairsDone);
+        }
+    }
+    else if(audioIndex && _prefs._audioPrefilter)  //only pairs sharing audio or where one video has no fingerprint
+    {
+        QVector<int> withoutAudio;
+        for(int i = 0; i < _videos.size(); i++)
+            if(!audioIndex->hasFingerprint(i))
+                withoutAudio << i;
+
+        #pragma omp parallel for schedule(dynamic)
+        for(int i = 0; i < _videos.size(); i++)
+        {
+            const int thread = omp_get_thread_num();
+            if(audioIndex->hasFingerprint(i))
+            {
+                for(auto audio=audioCandidates[i].cbegin(); audio!=audioCandidates[i].cend(); audio++)
+                    comparePair(thread, i, audio.key());        //candidates all have larger index
+                const auto silent = std::upper_bound(withoutAudio.cbegin(), withoutAudio.cend(), i);
+                for(auto j=silent; j!=withoutAudio.cend(); j++)
+                    comparePair(thread, i, *j);
+                pairsCompared += audioCandidates[i].count() + (withoutAudio.cend() - silent);
+            }
+            else
+            {
+                for(int j = i + 1; j < _videos.size(); j++)
+                    comparePair(thread, i, j);
+                pairsCompared += _videos.size() - 1 - i;
+            }
 
+            pairsDone += _videos.size() - 1 - i;
+            if(thread == 0)
+                showPreprocessProgress(pairsDone);
+        }
+    }
+    else                //threshold too low for index (ssim mode): all pairs, in blocks that stay in cache
+    {
+        TileScheduler tiles(_videos.size());
+        #pragma omp parallel
+        {
+            const int thread = omp_get_thread_num();
+            Tile tile;
+            while(tiles.next(tile))
+            {
+                for(int i = tile.rowStart; i < tile.rowEnd; i++)
+                    for(int j = qMax(i + 1, tile.columnStart); j < tile.columnEnd; j++)
+                        comparePair(thread, i, j);
+
+                pairsCompared += tile.pairs;
+                pairsDone += tile.pairs;
+                if(thread == 0)
+                    showPreprocessProgress(pairsDone);
+            }
+        }
+    }
+
+    if(_prefs._temporal)        //trimmed or split videos: frame sequences are aligned through an index, not all pairs
+    {
+        const TemporalIndex index(_videos, 64 - _prefs._thresholdPhash, _prefs._temporalMinFrames);
+        #pragma omp parallel for schedule(dynamic)
+        for(int i = 0; i < _videos.size(); i++)
+        {
+            if(filteredOut(_videos.at(i)))
+                continue;
+            const QHash<int, TemporalMatch> matches = index.matches(i);
+            for(auto match=matches.cbegin(); match!=matches.cend(); match++)
+            {
+                const double similarity = temporalSimilarity(match.value());
+                if(similarity && !filteredOut(_videos.at(match.key())))
+                    temporalMatches[omp_get_thread_num()] << PairMatch{ i, match.key(), similarity };
+            }
+        }
+    }
 
-    //_preprocessedVideos.append(vec_private);
+    addMatches(captureMatches);
+    addMatches(audioMatches);
+    addMatches(temporalMatches);
+    Metrics::instance().count("pairs compared", pairsCompared);
+    Metrics::instance().count("matches found", _preprocessedVideos.length());
 
     _leftVideo=0;
     _rightVideo=0;
@@ -250,78 +385,57 @@ void Comparison::on_preprocessVideo_clicked()
     on_nextVideo_clicked();
 }
 
-double Comparison::bothVideosMatch(const Video *left, const Video *right)
+void Comparison::showPreprocessProgress(const int64_t &pairsDone) const
 {
-    _phashSimilarity = 0;
-    double phashSimilarityResult = 0;
+    const int64_t allPairs = static_cast<int64_t>(_videos.size()) * (_videos.size() - 1) / 2;
+    const int percent = allPairs? static_cast<int>(100 * pairsDone / allPairs) : 100;
+    if(percent == ui->progressBar->value())
+        return;
+    ui->progressBar->setValue(percent);
+    ui->progressBar->repaint();                 //event loop is not running until preprocessing is done
+}
 
+bool Comparison::filteredOut(const Video *video) const
+{
     //size and time filters
     const QString filter_out = "error";
 
-    if(left->filename.contains(filter_out))
-        return false;
+    if(video->filename.contains(filter_out))
+        return true;
 
-    if(right->filename.contains(filter_out))
-        return false;
+    if(video->size < _prefs._minSizeBytes)
+        return true;
 
-    if(left->size < _prefs._minSizeBytes)
-        return false;
+    if(video->duration < _prefs._minTimeMs)
+        return true;
 
-    if(left->duration < _prefs._minTimeMs)
-        return false;
+    return false;
+}
 
-    if(right->size < _prefs._minSizeBytes)
-        return false;
+double Comparison::bothVideosMatch(const Video *left, const Video *right, const bool &alignSequences) const
+{
+    if(filteredOut(left) || filteredOut(right))
+        return 0;
 
-    if(right->duration < _prefs._minTimeMs)
-        return false;
+    const MatchScore score = _scoring.score(left, right);
+    if(score.match)
+        return score.similarity;
 
-    const int hashes = _prefs._thumbnails == cutEnds? 16 : 1;
-    for(int left_hash=0; left_hash<hashes; left_hash++)
-    {                               //if cutEnds mode: similarity is always the best one of both comparisons
-        for(int right_hash=0; right_hash<hashes; right_hash++)
-        {
-            phashSimilarityResult = qMax((int)phashSimilarityResult, phashSimilarity(left, right, left_hash, right_hash));
-            _phashSimilarity = phashSimilarityResult;
-            if(_prefs._comparisonMode == _prefs._PHASH)
-            {
-                if(phashSimilarityResult >= _prefs._thresholdPhash && phashSimilarityResult <= _prefs._thresholdPhashMax )
-                    return phashSimilarityResult;
-            }                           //ssim comparison is slow, only do it if pHash differs at most 20 bits of 64
-            else if(phashSimilarityResult >= qMax(_prefs._thresholdPhash, 44))
-            {
-                phashSimilarityResult = ssim(left->grayThumb[left_hash], right->grayThumb[right_hash], _prefs._ssimBlockSize);
-                phashSimilarityResult = phashSimilarityResult + _durationModifier / 64.0;   // b/64 bits (phash) <=> p/100 % (ssim)
-                _phashSimilarity = phashSimilarityResult;
-                if(phashSimilarityResult > _prefs._thresholdSSIM && phashSimilarityResult <= _prefs._thresholdSSIMMax){
-                    return phashSimilarityResult;
-                }
-            }
-        }
-    }
+    if(_prefs._temporal && alignSequences)      //captures differ, but one video may be a trimmed part of other
+        return temporalSimilarity(Temporal::align(left->temporal, right->temporal,
+                                                  64 - _prefs._thresholdPhash, _prefs._temporalMinFrames));
     return 0;
 }
 
-int Comparison::phashSimilarity(const Video *left, const Video *right, const int &leftHash, const int &rightHash)
+double Comparison::temporalSimilarity(const TemporalMatch &match) const
 {
-    if(left->hash[leftHash] == 0 && right->hash[rightHash] == 0)
+    if(!match.matched)
         return 0;
-
-    int distance = 64;
-    uint64_t differentBits = left->hash[leftHash] ^ right->hash[rightHash];    //XOR to value (only ones for differing bits)
-    while(differentBits)
-    {
-        differentBits &= differentBits - 1;                 //count number of bits of value
-        distance--;
-    }
-
-    if( qAbs(left->duration - right->duration) <= 1000 )
-        _durationModifier = 0 + _prefs._sameDurationModifier;               //lower distance if both durations within 1s
-    else
-        _durationModifier = 0 - _prefs._differentDurationModifier;          //raise distance if both durations differ 1s
-
-    distance = distance + _durationModifier;
-    return distance > 64? 64 : distance;
+    const int sameBits = qRound(64 * match.similarity);     //average identical bits of aligned frames
+    if(_prefs._comparisonMode == _prefs._PHASH)
+        return sameBits >= _prefs._thresholdPhash && sameBits <= _prefs._thresholdPhashMax? sameBits : 0;
+    const double similarity = sameBits / 64.0;              //b/64 bits (phash) <=> p/100 % (ssim), same as Scoring
+    return similarity > _prefs._thresholdSSIM && similarity <= _prefs._thresholdSSIMMax? similarity : 0;
 }
 
 void Comparison::showVideo(const QString &side) const
@@ -331,10 +445,7 @@ void Comparison::showVideo(const QString &side) const
         thisVideo = get_right_video();
 
     auto *Image = this->findChild<ClickableLabel *>(side + QStringLiteral("Image"));
-    QBuffer pixels(&thisVideo->thumbnail);
-    QImage image;
-    image.load(&pixels, QByteArrayLiteral("JPG"));
-    Image->setPixmap(QPixmap::fromImage(image).scaled(Image->width(), Image->height(), Qt::KeepAspectRatio));
+    Image->setPixmap(QPixmap::fromImage(_prefetcher.thumbnail(thisVideo, Image->size())));
 
     auto *FileName = this->findChild<ClickableLabel *>(side + QStringLiteral("FileName"));
     FileName->setText(QFileInfo(thisVideo->filename).fileName());
@@ -376,6 +487,17 @@ void Comparison::showVideo(const QString &side) const
     Audio->setText(thisVideo->audio);
 }
 
+void Comparison::prefetchNearbyPairs()
+{
+    QVector<const Video *> nearby;          //next pairs first (or previous ones if going backwards)
+    const int direction = _seekForwards? 1 : -1;
+    for(int distance=1; distance<=_prefetchPairs; distance++)
+        for(const int index : { _vectorIndex + direction * distance, _vectorIndex - direction * distance })
+            if(index >= 0 && index < _preprocessedVideos.length())
+                nearby << _preprocessedVideos[index].first << _preprocessedVideos[index].second;
+    _prefetcher.prefetch(nearby, ui->leftImage->size());
+}
+
 QString Comparison::readableDuration(const int64_t &milliseconds) const
 {
     if(milliseconds == 0)
@@ -513,6 +635,8 @@ void Comparison::updateUI()
     if(_prefs._comparisonMode == _prefs._SSIM)
         ui->identicalBits->setText(QString("%1 SSIM index").arg(QString::number(qMin(_ssimSimilarity, 1.0), 'f', 3)));
     _zoomLevel = 0;
+    _zoomPending = false;
+    fetchZoomCaptures();
     ui->progressBar->setValue(comparisonsSoFar());
 }
 
@@ -552,8 +676,7 @@ void Comparison::deleteVideo(const QString &side)
 
     const QString filename = thisVideo->filename;
     const QString onlyFilename = filename.right(filename.length() - filename.lastIndexOf("/") - 1);
-    const Db cache(filename,  _prefs._mainwPtr);                       //generate unique id before file has been deleted
-    const QString id = cache.uniqueId(filename, thisVideo->modified, "");
+    const Db cache(filename,  _prefs._mainwPtr);
 
     if(!QFileInfo::exists(filename))                //video was already manually deleted, skip to next
     {
@@ -569,7 +692,8 @@ void Comparison::deleteVideo(const QString &side)
         {
             _videosDeleted++;
             _spaceSaved = _spaceSaved + thisVideo->size;
-            cache.removeVideo(id);
+            _prefetcher.forget(thisVideo);
+            cache.removePath(filename);         //cached features stay, an identical copy may still use them
             emit sendStatusMessage(QString("Deleted %1").arg(QDir::toNativeSeparators(filename)));
             _seekForwards? on_nextVideo_clicked() : on_prevVideo_clicked();
         }
@@ -595,6 +719,8 @@ void Comparison::moveVideo(const QString &from, const QString &to)
             QMessageBox::information(this, "", "Could not move file. Check file permissions and available disk space.");
         else
         {
+            _prefetcher.forget(get_left_video());
+            _prefetcher.forget(get_right_video());
             emit sendStatusMessage(QString("Moved %1 to %2").arg(QDir::toNativeSeparators(from), toPath));
             _seekForwards? on_nextVideo_clicked() : on_prevVideo_clicked();
         }
@@ -609,14 +735,12 @@ void Comparison::on_swapFilenames_clicked() const
     const QFileInfo leftVideoFile(leftVideo->filename);
     const QString leftPathname = leftVideoFile.absolutePath();
     const QString oldLeftFilename = leftVideoFile.fileName();
-    const QDateTime oldLeftDatetime = leftVideo->modified;
     const QString oldLeftNoExtension = oldLeftFilename.left(oldLeftFilename.lastIndexOf("."));
     const QString leftExtension = oldLeftFilename.right(oldLeftFilename.length() - oldLeftFilename.lastIndexOf("."));
 
     const QFileInfo rightVideoFile(rightVideo->filename);
     const QString rightPathname = rightVideoFile.absolutePath();
     const QString oldRightFilename = rightVideoFile.fileName();
-    const QDateTime oldRightDatetime = rightVideo->modified;
     const QString oldRightNoExtension = oldRightFilename.left(oldRightFilename.lastIndexOf("."));
     const QString rightExtension = oldRightFilename.right(oldRightFilename.length() - oldRightFilename.lastIndexOf("."));
 
@@ -638,9 +762,7 @@ void Comparison::on_swapFilenames_clicked() const
     ui->leftFileName->setText(newLeftFilename);                     //update UI
     ui->rightFileName->setText(newRightFilename);
 
-    Db cache(leftVideo->filename,  _prefs._mainwPtr);
-    cache.removeVideo(cache.uniqueId(oldLeftFilename, oldLeftDatetime, ""));             //remove both videos from cache
-    cache.removeVideo(cache.uniqueId(oldRightFilename, oldRightDatetime, ""));
+    updateCachedPaths(leftVideo, rightVideo);
 }
 
 //should swap folder names
@@ -656,7 +778,6 @@ void Comparison::on_swapFolders_clicked() const
     QDir leftDir = leftVideoFile.dir();
     const QString leftDirName = leftDir.dirName();
     const QString leftDirPath = leftDir.absolutePath();
-    const QDateTime oldLeftDatetime = leftVideo->modified;
 
 
     leftDir.cdUp();
@@ -667,7 +788,6 @@ void Comparison::on_swapFolders_clicked() const
     QDir rightDir = rightVideoFile.dir();
     const QString rightDirName = rightDir.dirName();
     const QString rightDirPath = rightDir.absolutePath();
-    const QDateTime oldRightDatetime = rightVideo->modified;
 
 
     rightDir.cdUp();
@@ -689,9 +809,7 @@ void Comparison::on_swapFolders_clicked() const
     ui->leftPathName->setText(newLeftPath);                     //update UI
     ui->rightPathName->setText(newRightPath);
 
-    Db cache(leftVideo->filename,  _prefs._mainwPtr);
-    cache.removeVideo(cache.uniqueId(leftFilename, oldLeftDatetime, ""));             //remove both videos from cache
-    cache.removeVideo(cache.uniqueId(rightFilename, oldRightDatetime, ""));
+    updateCachedPaths(leftVideo, rightVideo);
 }
 
 //should swap folder names
@@ -706,7 +824,6 @@ void Comparison::on_swapFilesToFolders_clicked() const
     const QString leftFilename = leftVideoFile.fileName();
     const QString leftNoExtension = leftFilename.left(leftFilename.lastIndexOf("."));
     const QString leftExtension = leftFilename.right(leftFilename.length() - leftFilename.lastIndexOf("."));
-    const QDateTime oldLeftDatetime = leftVideo->modified;
 
     QDir leftDir = leftVideoFile.dir();
     const QString leftDirName = leftDir.dirName();
@@ -719,7 +836,6 @@ void Comparison::on_swapFilesToFolders_clicked() const
     const QString rightFilename = rightVideoFile.fileName();
     const QString rightNoExtension = rightFilename.left(rightFilename.lastIndexOf("."));
     const QString rightExtension = rightFilename.right(rightFilename.length() - rightFilename.lastIndexOf("."));
-    const QDateTime oldRightDatetime = rightVideo->modified;
 
     QDir rightDir = rightVideoFile.dir();
     const QString rightDirName = rightDir.dirName();
@@ -757,9 +873,21 @@ void Comparison::on_swapFilesToFolders_clicked() const
     ui->leftFileName->setText(newLeftFilenameAfterRename);
     ui->rightFileName->setText(newRightFilenameAfterRename);
 
-    Db cache(leftVideo->filename,  _prefs._mainwPtr);
-    cache.removeVideo(cache.uniqueId(leftFilename, oldLeftDatetime, ""));             //remove both videos from cache
-    cache.removeVideo(cache.uniqueId(rightFilename, oldRightDatetime, ""));
+    updateCachedPaths(leftVideo, rightVideo);
+}
+
+void Comparison::updateCachedPaths(const Video *left, const Video *right) const
+{
+    const Db cache(left->filename,  _prefs._mainwPtr);         //content ids stay, so cached features are kept
+    QHash<QString, CachedPath> paths;
+    for(const Video *video : { left, right })
+    {
+        CachedPath &cached = paths[video->filename];
+        cached.size = video->size;
+        cached.modified = video->modified;
+        cached.id = video->id;
+    }
+    cache.writePaths(paths);
 }
 
 void Comparison::on_thresholdSlider_valueChanged(const int &value)
@@ -813,18 +941,71 @@ void Comparison::resizeEvent(QResizeEvent *event)
 {
     Q_UNUSED(event)
 
+    showThumbnails();
+}
+
+void Comparison::showThumbnails()
+{
     if(ui->leftFileName->text().isEmpty() || _leftVideo >= _prefs._numberOfVideos || _rightVideo >= _prefs._numberOfVideos)
         return;     //automatic initial resize event can happen before closing when values went over limit
 
-    QImage image;
-    QBuffer leftPixels(&get_left_video()->thumbnail);
-    image.load(&leftPixels, QByteArrayLiteral("JPG"));
+    ui->leftImage->setPixmap(QPixmap::fromImage(_prefetcher.thumbnail(get_left_video(), ui->leftImage->size())));
+    ui->rightImage->setPixmap(QPixmap::fromImage(_prefetcher.thumbnail(get_right_video(), ui->rightImage->size())));
+}
+
+void Comparison::fetchZoomCaptures()
+{
+    QVector<const Video *> wanted = { get_left_video(), get_right_video() };
+    const int next = _vectorIndex + (_seekForwards? 1 : -1);    //user will probably zoom next pair too
+    if(next >= 0 && next < _preprocessedVideos.length())
+        wanted << _preprocessedVideos[next].first << _preprocessedVideos[next].second;
+
+    for(auto capture=_zoomCaptures.begin(); capture!=_zoomCaptures.end(); )
+        if(!wanted.contains(capture.key()))
+        {
+            capture.value()->disconnect(this);
+            capture.value()->deleteLater();     //a capture still running finishes in background and is discarded
+            capture = _zoomCaptures.erase(capture);
+        }
+        else
+            capture++;
+
+    for(const Video *video : wanted)
+        if(!_zoomCaptures.contains(video))
+        {
+            auto *watcher = new QFutureWatcher<QImage>(this);
+            connect(watcher, SIGNAL(finished()), this, SLOT(zoomCaptureFinished()));
+            watcher->setFuture(QtConcurrent::run(&_zoomPool, [video]() { return video->captureAt(10); }));
+            _zoomCaptures[video] = watcher;
+        }
+}
+
+void Comparison::zoomCaptureFinished()
+{
+    if(!_zoomPending)
+        return;
+
+    const QFutureWatcher<QImage> *left = _zoomCaptures.value(get_left_video());
+    const QFutureWatcher<QImage> *right = _zoomCaptures.value(get_right_video());
+    if(!left || !right || !left->isFinished() || !right->isFinished())
+        return;
+    _zoomPending = false;
+
+    QImage image = left->result();
     ui->leftImage->setPixmap(QPixmap::fromImage(image).scaled(
                              ui->leftImage->width(), ui->leftImage->height(), Qt::KeepAspectRatio));
-    QBuffer rightPixels(&get_right_video()->thumbnail);
-    image.load(&rightPixels, QByteArrayLiteral("JPG"));
+    _leftZoomed = QPixmap::fromImage(image);      //keep it in memory
+    _leftW = image.width();
+    _leftH = image.height();
+
+    image = right->result();
     ui->rightImage->setPixmap(QPixmap::fromImage(image).scaled(
                               ui->rightImage->width(), ui->rightImage->height(), Qt::KeepAspectRatio));
+    _rightZoomed = QPixmap::fromImage(image);
+    _rightW = image.width();
+    _rightH = image.height();
+
+    _zoomLevel = 1;
 }
 
 void Comparison::wheelEvent(QWheelEvent *event)
@@ -851,27 +1032,10 @@ void Comparison::wheelEvent(QWheelEvent *event)
     if(pos.x() > wmax || pos.y() < imgTop || pos.y() > imgBtm)      //image is smaller than label underneath
         return;
 
-    if(_zoomLevel == 0)     //first mouse wheel movement: retrieve actual screen captures in full resolution
+    if(_zoomLevel == 0)     //first mouse wheel movement: show actual screen captures in full resolution
     {
-        QApplication::setOverrideCursor(Qt::WaitCursor);
-
-        QImage image;
-        image = get_left_video()->captureAt(10);
-        ui->leftImage->setPixmap(QPixmap::fromImage(image).scaled(
-                                 ui->leftImage->width(), ui->leftImage->height(), Qt::KeepAspectRatio));
-        _leftZoomed = QPixmap::fromImage(image);      //keep it in memory
-        _leftW = image.width();
-        _leftH = image.height();
-
-        image = get_right_video()->captureAt(10);
-        ui->rightImage->setPixmap(QPixmap::fromImage(image).scaled(
-                                  ui->rightImage->width(), ui->rightImage->height(), Qt::KeepAspectRatio));
-        _rightZoomed = QPixmap::fromImage(image);
-        _rightW = image.width();
-        _rightH = image.height();
-
-        _zoomLevel = 1;
-        QApplication::restoreOverrideCursor();
+        _zoomPending = true;
+        zoomCaptureFinished();              //if they are still being taken, they are shown when ready
         return;
     }
 
@@ -5,7 +5,14 @@
 #include <QDesktopServices>
 #include <QUrl>
 #include <QLabel>
+#include <QFutureWatcher>
+#include <QThreadPool>
 #include "video.h"
+#include "temporal.h"
+#include "hashindex.h"
+#include "scoring.h"
+#include "tiles.h"
+#include "prefetcher.h"
 
 namespace Ui { class Comparison; }
 
@@ -32,11 +39,16 @@ private:
     int64_t _spaceSaved = 0;
     bool _seekForwards = true;
 
-    int _durationModifier = 0;
+    const Scoring _scoring;                 //reads _prefs, so thresholds changed in this window apply to it
     int _phashSimilarity = 0;
     double _ssimSimilarity = 0.0;
 
+    mutable Prefetcher _prefetcher;         //thumbnails and file existence of nearby pairs, loaded in background
+
     int _zoomLevel = 0;
+    bool _zoomPending = false;              //mouse wheel moved before full resolution captures were ready
+    QThreadPool _zoomPool;
+    QHash<const Video *, QFutureWatcher<QImage> *> _zoomCaptures;  //of current and next pair, taken in background
     QPixmap _leftZoomed;
     int _leftW = 0;
     int _leftH = 0;
@@ -51,14 +63,21 @@ public slots:
 
 private slots:
     void confirmToExit();
+    void showThumbnails();                  //current pair again, when a thumbnail read from cache is ready
     void on_prevVideo_clicked();
     void on_nextVideo_clicked();
     void on_preprocessVideo_clicked();
 
-    double bothVideosMatch(const Video *left, const Video *right);
-    int phashSimilarity(const Video *left, const Video *right, const int &leftHash, const int &rightHash);
+    //alignSequences: also align frame sequences of the pair, slow. Preprocessing finds those through TemporalIndex instead
+    double bothVideosMatch(const Video *left, const Video *right, const bool &alignSequences=false) const;
+    bool filteredOut(const Video *video) const;
+    void showPreprocessProgress(const int64_t &pairsDone) const;
+    double temporalSimilarity(const TemporalMatch &match) const;
 
     void showVideo(const QString &side) const;
+    void prefetchNearbyPairs();
+    bool bothVideosExist(const Video *left, const Video *right) const
+        { return _prefetcher.exists(left) && _prefetcher.exists(right); }
     QString readableDuration(const int64_t &milliseconds) const;
     QString readableFileSize(const int64_t &filesize) const;
     QString readableBitRate(const double &kbps) const;
@@ -94,6 +113,7 @@ private slots:
     void on_swapFilenames_clicked() const;
     void on_swapFolders_clicked() const;
     void on_swapFilesToFolders_clicked() const;
+    void updateCachedPaths(const Video *left, const Video *right) const;
 
 
     void on_thresholdSlider_valueChanged(const int &value);
@@ -101,10 +121,8 @@ private slots:
 
     void resizeEvent(QResizeEvent *event);
     void wheelEvent(QWheelEvent *event);
-
-    double sigma(const cv::Mat &m, const int &i, const int &j, const int &block_size) const;
-    double covariance(const cv::Mat &m0, const cv::Mat &m1, const int &i, const int &j, const int &block_size) const;
-    double ssim(const cv::Mat &m0, const cv::Mat &m1, const int &block_size) const;
+    void fetchZoomCaptures();
+    void zoomCaptureFinished();
 
 signals:
     void sendStatusMessage(const QString &message) const;
@@ -112,6 +130,10 @@ signals:
     void adjustThresholdSlider(const int &value) const;
     void adjustThresholdSliderMax(const int &value) const;
 
+private:
+    static constexpr int _prefetchPairs = 8;            //pairs prefetched in both directions from current one
+    static constexpr int _thumbnailCacheSize = 4 * _prefetchPairs + 4;
+    static constexpr int _zoomThreads = 2;              //one ffmpeg for each side
 };
 
 
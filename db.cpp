@@ -1,18 +1,43 @@
 #include <QApplication>
 #include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
 #include <QSqlQuery>
+#include <QDataStream>
 #include "db.h"
 #include "video.h"
+#include "metrics.h"
+#include "capturecodec.h"
 #include <QSqlError>
 #include <QElapsedTimer>
 #include <QDebug>
 
+QString Db::_cacheFile;
+
+namespace
+{
+    const int capturePercents[] = { 8, 16, 24, 32, 36, 40, 48, 52, 56, 60, 64, 68, 72, 80, 88, 96 };     //column at<percent>
+}
+
+QString Db::cacheFile()
+{
+    if(_cacheFile.isEmpty())
+        return QStringLiteral("%1/cache.db").arg(QApplication::applicationDirPath());
+    return _cacheFile;
+}
+
+QString Db::cacheFolder()
+{
+    return QFileInfo(cacheFile()).absolutePath();
+}
+
 Db::Db(const QString &connectionParam, QWidget *mainwPtr)
 {
     _connection = connectionParam;       //connection name is unique (generated from full path+filename)
 
-    const QString dbfilename = QStringLiteral("%1/cache.db").arg(QApplication::applicationDirPath());
-    connect(this, SIGNAL(sendStatusMessage(const QString &)), mainwPtr, SLOT(addStatusMessage(const QString &)));
+    const QString dbfilename = cacheFile();
+    if(mainwPtr)                         //no window when used from command line or benchmark
+        connect(this, SIGNAL(sendStatusMessage(const QString &)), mainwPtr, SLOT(addStatusMessage(const QString &)));
 
     _db = QSqlDatabase::addDatabase(QStringLiteral("QSQLITE"), _connection);
     _db.setDatabaseName(dbfilename);
@@ -30,24 +55,406 @@ QString Db::uniqueId(const QString &filename, const QDateTime &dateMod, const QS
     return QCryptographicHash::hash(name_modified.toLatin1(), QCryptographicHash::Md5).toHex();
 }
 
+QString Db::contentId(const QString &filename)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly))
+        return QString();
+
+    const qint64 size = file.size();
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(QByteArray::number(size));
+    const qint64 offsets[] = { 0, size / 2 - _sampleSize / 2, size - _sampleSize };    //beginning, middle and end
+    for(const qint64 offset : offsets)
+    {
+        file.seek(qMax(static_cast<qint64>(0), offset));
+        hash.addData(file.read(_sampleSize));
+    }
+    return hash.result().toHex();
+}
+
+QString Db::fullContentHash(const QString &filename)
+{
+    QFile file(filename);
+    if(!file.open(QIODevice::ReadOnly))
+        return filename;                    //unreadable file is identical only to itself
+    QCryptographicHash hash(QCryptographicHash::Md5);
+    hash.addData(&file);
+    return hash.result().toHex();
+}
+
+QHash<QString, CachedPath> Db::readPaths() const
+{
+    QHash<QString, CachedPath> paths;
+    QSqlQuery query(_db);
+    query.exec(QStringLiteral("SELECT path, size, modified, id FROM path;"));
+    while(query.next())
+    {
+        CachedPath &cached = paths[query.value(0).toString()];
+        cached.size = query.value(1).toLongLong();
+        cached.modified = QDateTime::fromMSecsSinceEpoch(query.value(2).toLongLong());
+        cached.id = query.value(3).toString();
+    }
+    return paths;
+}
+
+void Db::writePaths(const QHash<QString, CachedPath> &paths) const
+{
+    QSqlQuery transaction(_db);
+    transaction.exec(QStringLiteral("BEGIN TRANSACTION;"));         //one disk write for whole folder scan
+    QSqlQuery query(_db);
+    query.prepare(QStringLiteral("INSERT OR REPLACE INTO path (path, size, modified, id) VALUES (?, ?, ?, ?)"));
+    for(auto cached=paths.cbegin(); cached!=paths.cend(); cached++)
+    {
+        query.addBindValue(cached.key());
+        query.addBindValue(static_cast<qint64>(cached.value().size));
+        query.addBindValue(cached.value().modified.toMSecsSinceEpoch());
+        query.addBindValue(cached.value().id);
+        if (!query.exec())
+            qWarning() << "Failed to insert path:" << query.lastError().text();
+    }
+    transaction.exec(QStringLiteral("COMMIT;"));
+}
+
+void Db::removePath(const QString &path) const
+{
+    QSqlQuery query(_db);
+    query.prepare(QStringLiteral("DELETE FROM path WHERE path = ?"));
+    query.addBindValue(path);
+    query.exec();
+}
+
+int Db::adoptLegacyIds(const QHash<QString, QString> &contentIds) const
+{
+    int adopted = 0;
+    QSqlQuery query(_db);
+    const QStringList tables = { QStringLiteral("metadata"), QStringLiteral("capture"), QStringLiteral("temporal"),
+                                 QStringLiteral("audio"), QStringLiteral("crop") };
+    query.exec(QStringLiteral("BEGIN TRANSACTION;"));
+    for(auto id=contentIds.cbegin(); id!=contentIds.cend(); id++)
+    {
+        query.prepare(QStringLiteral("SELECT 1 FROM metadata WHERE id = ?;"));
+        query.addBindValue(id.key());
+        if(!query.exec() || !query.next())      //nearly always: file is new, not an old cache entry
+            continue;
+        for(const auto &table : tables)         //identical copy may be cached under content id already, that row is kept
+        {
+            query.prepare(QStringLiteral("UPDATE OR IGNORE %1 SET id = ? WHERE id = ?;").arg(table));
+            query.addBindValue(id.value());
+            query.addBindValue(id.key());
+            query.exec();
+            query.prepare(QStringLiteral("DELETE FROM %1 WHERE id = ?;").arg(table));
+            query.addBindValue(id.key());
+            query.exec();
+        }
+        adopted++;
+    }
+    query.exec(QStringLiteral("COMMIT;"));
+    if(adopted)
+        emit sendStatusMessage(QStringLiteral("%1 video(s) cached by older version moved to content ids").arg(adopted));
+    return adopted;
+}
+
+int Db::merge(const QString &otherCache, const QString &fromPrefix, const QString &toPrefix) const
+{
+    if(!QFileInfo::exists(otherCache))
+        return -1;
+    QSqlQuery query(_db);
+    query.prepare(QStringLiteral("ATTACH DATABASE ? AS other;"));
+    query.addBindValue(otherCache);
+    if(!query.exec())
+        return -1;
+
+    int merged = 0;
+    query.exec(QStringLiteral("BEGIN TRANSACTION;"));
+    const QStringList tables = { QStringLiteral("metadata"), QStringLiteral("capture"), QStringLiteral("temporal"),
+                                 QStringLiteral("audio"), QStringLiteral("crop") };
+    for(const auto &table : tables)                 //same content has same id everywhere, rows already here are kept
+    {
+        QStringList columns;                        //other cache may be of older schema version
+        query.exec(QStringLiteral("PRAGMA other.table_info(%1);").arg(table));
+        while(query.next())
+            columns << query.value(1).toString();
+        if(!columns.isEmpty() && query.exec(QStringLiteral("INSERT OR IGNORE INTO main.%1 (%2) SELECT %2 FROM other.%1;")
+                                            .arg(table, columns.join(QStringLiteral(", ")))))
+            merged += query.numRowsAffected();
+    }
+
+    query.prepare(QStringLiteral("INSERT OR REPLACE INTO main.path (path, size, modified, id) "
+                                 "SELECT CASE WHEN substr(path, 1, length(:from)) = :from "
+                                 "THEN :to || substr(path, length(:from) + 1) ELSE path END, "
+                                 "size, modified, id FROM other.path;"));
+    query.bindValue(QStringLiteral(":from"), fromPrefix);
+    query.bindValue(QStringLiteral(":to"), toPrefix);
+    if(query.exec())
+        merged += query.numRowsAffected();
+    query.exec(QStringLiteral("COMMIT;"));
+    query.exec(QStringLiteral("DETACH DATABASE other;"));
+    return merged;
+}
+
+qint64 Db::bytesUsed() const
+{
+    QSqlQuery query(_db);
+    qint64 pages = 0, pageSize = 0;
+    query.exec(QStringLiteral("PRAGMA page_count;"));
+    if(query.next())
+        pages = query.value(0).toLongLong();
+    query.exec(QStringLiteral("PRAGMA page_size;"));
+    if(query.next())
+        pageSize = query.value(0).toLongLong();
+    return pages * pageSize;
+}
+
+Cleanup Db::collectGarbage(const int &days) const
+{
+    Cleanup cleanup;
+    const qint64 before = bytesUsed();
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    QSqlQuery query(_db);
+
+    //access dates of older versions were not saved, those videos get full period from now instead of going at once
+    query.prepare(QStringLiteral("UPDATE metadata SET access_date = ? WHERE typeof(access_date) != 'integer';"));
+    query.addBindValue(now);
+    query.exec();
+
+    //a missing file in a missing folder may be on a drive that is not connected: forget path (cheap to
+    //find again), but leave its video to expire by date. A missing file in an existing folder was deleted
+    QStringList gonePaths;
+    QSet<QString> deletedIds;
+    QHash<QString, bool> folderExists;
+    query.exec(QStringLiteral("SELECT path, id FROM path;"));
+    while(query.next())
+    {
+        const QString path = query.value(0).toString();
+        if(QFileInfo::exists(path))
+            continue;
+        gonePaths << path;
+        const QString folder = QFileInfo(path).path();
+        if(!folderExists.contains(folder))
+            folderExists[folder] = QFileInfo::exists(folder);
+        if(folderExists[folder])
+            deletedIds << query.value(1).toString();
+    }
+
+    query.exec(QStringLiteral("BEGIN TRANSACTION;"));
+    query.prepare(QStringLiteral("DELETE FROM path WHERE path = ?;"));
+    for(const auto &path : gonePaths)
+    {
+        query.addBindValue(path);
+        if(query.exec())
+            cleanup.paths += query.numRowsAffected();
+    }
+
+    query.prepare(QStringLiteral("DELETE FROM metadata WHERE id = ? AND id NOT IN (SELECT id FROM path);"));
+    for(const auto &id : deletedIds)            //identical copy elsewhere keeps it
+    {
+        query.addBindValue(id);
+        if(query.exec())
+            cleanup.videos += query.numRowsAffected();
+    }
+
+    query.prepare(QStringLiteral("DELETE FROM metadata WHERE access_date < ?;"));
+    query.addBindValue(now - static_cast<qint64>(days) * 24 * 60 * 60);
+    if(query.exec())
+        cleanup.videos += query.numRowsAffected();
+
+    const QStringList tables = { QStringLiteral("capture"), QStringLiteral("temporal"),
+                                 QStringLiteral("audio"), QStringLiteral("crop") };
+    for(const auto &table : tables)
+        if(query.exec(QStringLiteral("DELETE FROM %1 WHERE id NOT IN (SELECT id FROM metadata);").arg(table)))
+            cleanup.orphans += query.numRowsAffected();
+    query.exec(QStringLiteral("COMMIT;"));
+
+    query.exec(QStringLiteral("PRAGMA auto_vacuum;"));
+    if(query.next() && query.value(0).toInt() == 2)
+        query.exec(QStringLiteral("PRAGMA incremental_vacuum;"));
+    else                                        //cache made by older version: rebuild once so it can shrink from now on
+    {
+        query.exec(QStringLiteral("PRAGMA auto_vacuum = INCREMENTAL;"));
+        query.exec(QStringLiteral("VACUUM;"));
+    }
+    query.exec(QStringLiteral("PRAGMA wal_checkpoint(TRUNCATE);"));
+
+    cleanup.bytesFreed = before - bytesUsed();
+    return cleanup;
+}
+
+int Db::captureFormat() const
+{
+    QSqlQuery query(_db);
+    query.exec(QStringLiteral("SELECT value FROM settings WHERE key = 'capture_format';"));
+    return query.next()? qMax(CaptureCodec::fromName(query.value(0).toString()), 0) : CaptureCodec::jpeg;
+}
+
+void Db::setCaptureFormat(const int &format) const
+{
+    QSqlQuery query(_db);
+    query.prepare(QStringLiteral("INSERT OR REPLACE INTO settings VALUES('capture_format', ?);"));
+    query.addBindValue(CaptureCodec::name(format));
+    query.exec();
+}
+
+int Db::convertCaptures(const int &format) const
+{
+    setCaptureFormat(format);
+    struct Blob
+    {
+        qint64 row;
+        int percent;
+        QByteArray data;
+    };
+
+    int converted = 0;
+    qint64 lastRow = 0;
+    QSqlQuery query(_db);
+    QStringList columns;
+    for(const int percent : capturePercents)
+        columns << QStringLiteral("at%1").arg(percent);
+    while(true)                                 //batches of rows, memory stays small and other processes are not blocked long
+    {
+        query.prepare(QStringLiteral("SELECT rowid, %1 FROM capture WHERE rowid > ? ORDER BY rowid LIMIT %2;")
+                      .arg(columns.join(QStringLiteral(", "))).arg(_convertBatch));
+        query.addBindValue(lastRow);
+        if(!query.exec())
+            break;
+        QVector<Blob> blobs;
+        int rows = 0;
+        while(query.next())
+        {
+            rows++;
+            lastRow = query.value(0).toLongLong();
+            for(int column=0; column<columns.count(); column++)
+            {
+                const QByteArray data = query.value(column + 1).toByteArray();
+                if(!data.isEmpty() && CaptureCodec::formatOf(data) != format)
+                    blobs << Blob{ lastRow, capturePercents[column], data };
+            }
+        }
+        if(rows == 0)
+            break;
+
+#pragma omp parallel for schedule(dynamic)
+        for(int i=0; i<blobs.count(); i++)
+        {
+            const QImage image = CaptureCodec::decode(blobs[i].data);
+            blobs[i].data = image.isNull()? QByteArray() : CaptureCodec::encode(image, format);
+        }
+
+        query.exec(QStringLiteral("BEGIN TRANSACTION;"));
+        for(const auto &blob : blobs)
+        {
+            if(blob.data.isEmpty())             //damaged, left as it is, it is taken again if needed
+                continue;
+            query.prepare(QStringLiteral("UPDATE capture SET at%1 = ? WHERE rowid = ?;").arg(blob.percent));
+            query.addBindValue(blob.data);
+            query.addBindValue(blob.row);
+            if(query.exec())
+                converted++;
+        }
+        query.exec(QStringLiteral("COMMIT;"));
+    }
+    query.exec(QStringLiteral("PRAGMA incremental_vacuum;"));
+    return converted;
+}
+
+void Db::touch(const QStringList &ids) const
+{
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    QSqlQuery query(_db);
+    query.exec(QStringLiteral("BEGIN TRANSACTION;"));
+    query.prepare(QStringLiteral("UPDATE metadata SET access_date = ? WHERE id = ?;"));
+    for(const auto &id : ids)
+    {
+        query.addBindValue(now);
+        query.addBindValue(id);
+        query.exec();
+    }
+    query.exec(QStringLiteral("COMMIT;"));
+}
+
 void Db::createTables() const
 {
     QSqlQuery query(_db);
     query.exec(QStringLiteral("PRAGMA synchronous = OFF;"));
+    query.exec(QStringLiteral("PRAGMA auto_vacuum = INCREMENTAL;"));        //only takes effect in new file
     query.exec(QStringLiteral("PRAGMA journal_mode = WAL;"));
 
-    query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS metadata (id TEXT PRIMARY KEY, "
-                              "size INTEGER, duration INTEGER, bitrate INTEGER, framerate REAL, "
-                              "codec TEXT, audio TEXT, width INTEGER, height INTEGER, access_date INTEGER);"));
-
-    query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS capture (id TEXT PRIMARY KEY, "
-                              " at8 BLOB, at16 BLOB, at24 BLOB, at32 BLOB, at36 BLOB, at40 BLOB, at48 BLOB, at52 BLOB, "
-                              "at56 BLOB, at60 BLOB, at64 BLOB, at68 BLOB, at72 BLOB, at80 BLOB, at88 BLOB, at96 BLOB);"));
+    query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS schema_version (version INTEGER);"));
+    while(true)                                 //one transaction per step, an interrupted upgrade continues next time
+    {
+        query.exec(QStringLiteral("BEGIN IMMEDIATE;"));     //other process using same cache waits instead of upgrading too
+        const int version = schemaVersion();
+        if(version >= _schemaVersion)
+        {
+            query.exec(QStringLiteral("COMMIT;"));
+            break;
+        }
+        if(!migrate(version))
+        {
+            query.exec(QStringLiteral("ROLLBACK;"));
+            qWarning() << "Cache upgrade from schema version" << version << "failed:" << query.lastError().text();
+            emit sendStatusMessage(QStringLiteral("Cache could not be upgraded from schema version %1").arg(version));
+            break;
+        }
+        query.exec(QStringLiteral("DELETE FROM schema_version;"));
+        query.exec(QStringLiteral("INSERT INTO schema_version VALUES(%1);").arg(version + 1));
+        query.exec(QStringLiteral("COMMIT;"));
+    }
 
     query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS version (version TEXT PRIMARY KEY);"));
     query.exec(QStringLiteral("INSERT OR REPLACE INTO version VALUES('%1');").arg(APP_VERSION));
 }
 
+int Db::schemaVersion() const
+{
+    QSqlQuery query(_db);
+    query.exec(QStringLiteral("SELECT version FROM schema_version;"));
+    return query.next()? query.value(0).toInt() : 0;
+}
+
+bool Db::addColumn(const QString &table, const QString &column, const QString &type) const
+{
+    QSqlQuery query(_db);
+    query.exec(QStringLiteral("PRAGMA table_info(%1);").arg(table));
+    while(query.next())
+        if(query.value(1).toString() == column)
+            return true;
+    return query.exec(QStringLiteral("ALTER TABLE %1 ADD COLUMN %2 %3;").arg(table, column, type));
+}
+
+//steps are never changed once released, a new column or table is a new step (and _schemaVersion + 1).
+//Caches made before schema was versioned are version 0, whatever tables they have
+bool Db::migrate(const int &from) const
+{
+    QSqlQuery query(_db);
+    switch(from)
+    {
+    case 0:                                     //tables of first versions, captures at 36/52/60/68 and access date came later
+        if(!query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS metadata (id TEXT PRIMARY KEY, "
+                                      "size INTEGER, duration INTEGER, bitrate INTEGER, framerate REAL, "
+                                      "codec TEXT, audio TEXT, width INTEGER, height INTEGER);")) ||
+           !addColumn(QStringLiteral("metadata"), QStringLiteral("access_date"), QStringLiteral("INTEGER")) ||
+           !query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS capture (id TEXT PRIMARY KEY);")))
+            return false;
+        for(const int percent : capturePercents)
+            if(!addColumn(QStringLiteral("capture"), QStringLiteral("at%1").arg(percent), QStringLiteral("BLOB")))
+                return false;
+        return true;
+    case 1:                                     //fingerprints, crops and paths of files
+        return query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS temporal (id TEXT PRIMARY KEY, "
+                                         "interval INTEGER, hashes BLOB);")) &&
+               query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS audio (id TEXT PRIMARY KEY, hashes BLOB);")) &&
+               query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS crop (id TEXT PRIMARY KEY, rects BLOB);")) &&
+               query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS path (path TEXT PRIMARY KEY, "
+                                         "size INTEGER, modified INTEGER, id TEXT);"));
+    case 2:                                     //settings of cache (capture format)
+        return query.exec(QStringLiteral("CREATE TABLE IF NOT EXISTS settings (key TEXT PRIMARY KEY, value TEXT);"));
+    default:
+        return false;
+    }
+}
+
 bool Db::readMetadata(Video &video) const
 {
     QSqlQuery query(_db);
@@ -70,15 +477,13 @@ bool Db::readMetadata(Video &video) const
 }
 /*
 //make hashmap
-void Db::populateMetadatas(const QHash<QString, Video *> _everyVideo) const
+void Db::populateMetadatas(const QMultiHash<QString, Video *> &_everyVideo) const
 {
     QSqlQuery query(_db);
     QString inArgs = "";
     int count = 0;
     const int limit = 5000;
     int now = QDateTime::currentSecsSinceEpoch();
-    //delete from capture where id in (select  capture.id from capture left join metadata on metadata.id = capture.id where metadata.id is null    )
-    //run compact databsae in menu
     QString updateQuery = QStringLiteral("UPDATE metadata set access_date = '%1' WHERE id in ").arg(now);
 
     QHashIterator<QString, Video *> i(_everyVideo);
@@ -115,10 +520,11 @@ void Db::populateMetadatas(const QHash<QString, Video *> _everyVideo) const
 }
 */
 
-void Db::populateMetadatas(const QHash<QString, Video *> _everyVideo) const
+void Db::populateMetadatas(const QMultiHash<QString, Video *> &_everyVideo) const
 {
+    const ScopedTimer timer("cache read");
     const int limit = 5000;
-    int now = QDateTime::currentSecsSinceEpoch();
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
 
     QSqlQuery updateQuery(_db);
     QSqlQuery selectQuery(_db);
@@ -139,8 +545,8 @@ void Db::populateMetadatas(const QHash<QString, Video *> _everyVideo) const
             QString inClause = quotedItems.join(", ");
 
             // Update access_date
-            updateQuery.prepare("UPDATE metadata SET access_date = " + QString(now) + " WHERE id IN (" + inClause + ")");
-            //updateQuery.addBindValue(now);
+            updateQuery.prepare("UPDATE metadata SET access_date = ? WHERE id IN (" + inClause + ")");
+            updateQuery.addBindValue(now);
 
             if (!updateQuery.exec()) {
                 qWarning() << "Update failed:" << updateQuery.lastError().text();
@@ -162,16 +568,17 @@ void Db::populateMetadatas(const QHash<QString, Video *> _everyVideo) const
                         continue;
                     }
 
-                    Video *video = _everyVideo[id];
-                    video->size = selectQuery.value("size").toLongLong();
-                    video->duration = selectQuery.value("duration").toLongLong();
-                    video->bitrate = selectQuery.value("bitrate").toInt();
-                    video->framerate = selectQuery.value("framerate").toDouble();
-                    video->codec = selectQuery.value("codec").toString();
-                    video->audio = selectQuery.value("audio").toString();
-                    video->width = static_cast<short>(selectQuery.value("width").toInt());
-                    video->height = static_cast<short>(selectQuery.value("height").toInt());
-                    video->cachedMetadata = true;
+                    for (Video *video : _everyVideo.values(id)) {       //identical copies share an id
+                        video->size = selectQuery.value("size").toLongLong();
+                        video->duration = selectQuery.value("duration").toLongLong();
+                        video->bitrate = selectQuery.value("bitrate").toInt();
+                        video->framerate = selectQuery.value("framerate").toDouble();
+                        video->codec = selectQuery.value("codec").toString();
+                        video->audio = selectQuery.value("audio").toString();
+                        video->width = static_cast<short>(selectQuery.value("width").toInt());
+                        video->height = static_cast<short>(selectQuery.value("height").toInt());
+                        video->cachedMetadata = true;
+                    }
                 }
             }
 
@@ -181,8 +588,9 @@ void Db::populateMetadatas(const QHash<QString, Video *> _everyVideo) const
 }
 
 //make hashmap
-void Db::populateCaptures(const QHash<QString, Video *> _everyVideo, const QVector<int> &percentages) const
+void Db::populateCaptures(const QMultiHash<QString, Video *> &_everyVideo, const QVector<int> &percentages) const
 {
+    const ScopedTimer timer("cache read");
     QSqlQuery query(_db);
     int count = 0;
     const int limit = 2000;
@@ -213,11 +621,11 @@ void Db::populateCaptures(const QHash<QString, Video *> _everyVideo, const QVect
              }
              while(query.next()){
                  const QString id = query.value("id").toString();
-                 Video *video = _everyVideo[id];
-                 for(auto percentage : percentages)
-                 {
-                     video->captures[percentage] = query.value(QStringLiteral("at%1").arg(percentage)).toByteArray();
-                 }
+                 for(Video *video : _everyVideo.values(id))
+                     for(auto percentage : percentages)
+                     {
+                         video->captures[percentage] = query.value(QStringLiteral("at%1").arg(percentage)).toByteArray();
+                     }
              }
              count = 0;
              inArgsList.clear();
@@ -225,9 +633,153 @@ void Db::populateCaptures(const QHash<QString, Video *> _everyVideo, const QVect
         }
     }
 }
+void Db::writeTemporal(const QString &id, const int &interval, const QVector<uint64_t> &hashes) const
+{
+    const ScopedTimer timer("cache write");
+    const QByteArray blob(reinterpret_cast<const char *>(hashes.constData()),
+                          hashes.count() * static_cast<int>(sizeof(uint64_t)));
+    QSqlQuery query(_db);
+    query.prepare(QStringLiteral("INSERT OR REPLACE INTO temporal (id, interval, hashes) VALUES (?, ?, ?)"));
+    query.addBindValue(id);
+    query.addBindValue(interval);
+    query.addBindValue(blob);
+
+    if (!query.exec())
+        qWarning() << "Failed to insert temporal fingerprint:" << query.lastError().text();
+}
+
+void Db::populateTemporals(const QMultiHash<QString, Video *> &_everyVideo, const int &interval) const
+{
+    const ScopedTimer timer("cache read");
+    QSqlQuery query(_db);
+    const int limit = 2000;
+    QStringList inArgsList;
+
+    QHashIterator<QString, Video *> i(_everyVideo);
+    while (i.hasNext()) {
+        i.next();
+        inArgsList << QString("'%1'").arg(i.key());
+
+        if(inArgsList.size() == limit || !i.hasNext()){
+            const QString query_string = QStringLiteral("SELECT id, hashes FROM temporal WHERE interval = %1 AND id in (%2);")
+                                         .arg(interval).arg(inArgsList.join(", "));
+            inArgsList.clear();
+            if (!query.exec(query_string)) {
+                qWarning() << "Query failed:" << query.lastError().text();
+                continue;
+            }
+            while(query.next()){
+                const QByteArray blob = query.value(1).toByteArray();
+                for(Video *video : _everyVideo.values(query.value(0).toString()))
+                {
+                    video->temporal.resize(blob.size() / static_cast<int>(sizeof(uint64_t)));
+                    memcpy(video->temporal.data(), blob.constData(), static_cast<size_t>(video->temporal.count()) * sizeof(uint64_t));
+                }
+            }
+            query.clear();
+        }
+    }
+}
+
+void Db::writeAudio(const QString &id, const QVector<uint32_t> &hashes) const
+{
+    const ScopedTimer timer("cache write");
+    const QByteArray blob(reinterpret_cast<const char *>(hashes.constData()),
+                          hashes.count() * static_cast<int>(sizeof(uint32_t)));
+    QSqlQuery query(_db);
+    query.prepare(QStringLiteral("INSERT OR REPLACE INTO audio (id, hashes) VALUES (?, ?)"));
+    query.addBindValue(id);
+    query.addBindValue(blob);
+
+    if (!query.exec())
+        qWarning() << "Failed to insert audio fingerprint:" << query.lastError().text();
+}
+
+void Db::populateAudio(const QMultiHash<QString, Video *> &_everyVideo) const
+{
+    const ScopedTimer timer("cache read");
+    QSqlQuery query(_db);
+    const int limit = 2000;
+    QStringList inArgsList;
+
+    QHashIterator<QString, Video *> i(_everyVideo);
+    while (i.hasNext()) {
+        i.next();
+        inArgsList << QString("'%1'").arg(i.key());
+
+        if(inArgsList.size() == limit || !i.hasNext()){
+            const QString query_string = QStringLiteral("SELECT id, hashes FROM audio WHERE id in (%1);")
+                                         .arg(inArgsList.join(", "));
+            inArgsList.clear();
+            if (!query.exec(query_string)) {
+                qWarning() << "Query failed:" << query.lastError().text();
+                continue;
+            }
+            while(query.next()){
+                const QByteArray blob = query.value(1).toByteArray();
+                for(Video *video : _everyVideo.values(query.value(0).toString()))
+                {
+                    video->audioHashes.resize(blob.size() / static_cast<int>(sizeof(uint32_t)));
+                    memcpy(video->audioHashes.data(), blob.constData(), static_cast<size_t>(video->audioHashes.count()) * sizeof(uint32_t));
+                    video->cachedAudio = true;
+                }
+            }
+            query.clear();
+        }
+    }
+}
+
+void Db::writeCrops(const QString &id, const QHash<int, QRectF> &crops) const
+{
+    const ScopedTimer timer("cache write");
+    QByteArray blob;
+    QDataStream stream(&blob, QIODevice::WriteOnly);
+    stream << crops;
+    QSqlQuery query(_db);
+    query.prepare(QStringLiteral("INSERT OR REPLACE INTO crop (id, rects) VALUES (?, ?)"));
+    query.addBindValue(id);
+    query.addBindValue(blob);
+
+    if (!query.exec())
+        qWarning() << "Failed to insert crop:" << query.lastError().text();
+}
+
+void Db::populateCrops(const QMultiHash<QString, Video *> &_everyVideo) const
+{
+    const ScopedTimer timer("cache read");
+    QSqlQuery query(_db);
+    const int limit = 2000;
+    QStringList inArgsList;
+
+    QHashIterator<QString, Video *> i(_everyVideo);
+    while (i.hasNext()) {
+        i.next();
+        inArgsList << QString("'%1'").arg(i.key());
+
+        if(inArgsList.size() == limit || !i.hasNext()){
+            const QString query_string = QStringLiteral("SELECT id, rects FROM crop WHERE id in (%1);")
+                                         .arg(inArgsList.join(", "));
+            inArgsList.clear();
+            if (!query.exec(query_string)) {
+                qWarning() << "Query failed:" << query.lastError().text();
+                continue;
+            }
+            while(query.next()){
+                for(Video *video : _everyVideo.values(query.value(0).toString()))
+                {
+                    QDataStream stream(query.value(1).toByteArray());
+                    stream >> video->crops;
+                }
+            }
+            query.clear();
+        }
+    }
+}
+
 void Db::writeMetadata(const Video &video) const
 {
-    int now = QDateTime::currentSecsSinceEpoch();
+    const ScopedTimer timer("cache write");
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
 
     QSqlQuery query(_db);
     query.prepare("INSERT OR REPLACE INTO metadata "
@@ -333,6 +885,7 @@ QHash<int, QByteArray>  Db::readCapturesOfVideos(const QVector<QString> &ids, co
 
 void Db::writeCapture(const QString &id, const int &percent, const QByteArray &image) const
 {
+    const ScopedTimer timer("cache write");
     QSqlQuery query(_db);
     query.exec(QStringLiteral("INSERT OR IGNORE INTO capture (id) VALUES('%1');").arg(id));
 
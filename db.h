@@ -7,6 +7,22 @@
 
 class Video;
 
+struct CachedPath
+{
+    int64_t size = 0;
+    QDateTime modified;
+    QString id;                 //content id of file when it had this size and modification date
+};
+
+//rows removed by Db::collectGarbage()
+struct Cleanup
+{
+    int paths = 0;              //files that no longer exist
+    int videos = 0;             //not seen for given days, or every file with that content was deleted
+    int orphans = 0;            //captures, fingerprints and crops of videos no longer in metadata
+    qint64 bytesFreed = 0;
+};
+
 class Db : public QObject {
     Q_OBJECT
 
@@ -20,14 +36,67 @@ private:
     //QString _id;
     //QDateTime _modified;
 
+    static QString _cacheFile;
+
+    static constexpr int _sampleSize = 65536;
+    static constexpr int _convertBatch = 500;  //capture rows converted in one transaction
+
+    qint64 bytesUsed() const;                  //pages of database file in use
+
+    static constexpr int _schemaVersion = 3;   //number of migration steps, tables and columns cache has now
+    int schemaVersion() const;                 //0 if cache was made before schema was versioned
+    bool migrate(const int &from) const;       //upgrades cache by one version, inside transaction of caller
+    bool addColumn(const QString &table, const QString &column, const QString &type) const;    //true if it exists
+
 signals:
     void sendStatusMessage(const QString &message) const;
 
 public:
+    //cache.db in program folder unless set from command line, must be set before any Db is opened
+    static void setCacheFile(const QString &filename) { _cacheFile = filename; }
+    static QString cacheFile();
+    static QString cacheFolder();              //snapshot and metrics are saved next to cache
+
+    //copy rows of cache made on another machine, paths starting with fromPrefix are rewritten to start
+    //with toPrefix (how this machine sees that folder). Returns number of rows added, -1 if not opened
+    int merge(const QString &otherCache, const QString &fromPrefix, const QString &toPrefix) const;
+
+    //evicts videos not seen for days and those whose files were all deleted, forgets paths that no longer
+    //exist, deletes rows left without metadata and returns free pages to file system
+    Cleanup collectGarbage(const int &days) const;
+
+    //how new captures are stored (CaptureCodec::Format), jpeg unless changed
+    int captureFormat() const;
+    void setCaptureFormat(const int &format) const;
+
+    //stores new captures in format and re-encodes cached ones, returns number converted
+    int convertCaptures(const int &format) const;
+
+    //videos were seen now, so collectGarbage() keeps them (only needed if they were not read from cache)
+    void touch(const QStringList &ids) const;
+
     //return md5 hash of parameter's file, or (as convinience) md5 hash of the file given to constructor
     static QString uniqueId(const QString &filename, const QDateTime &dateMod, const QString &id);
 
-    //constructor creates a database file if there is none already
+    //md5 hash of file size and three 64 kB chunks, stays the same when file is renamed, moved or touched
+    static QString contentId(const QString &filename);
+
+    //md5 hash of whole file, to confirm that files with same content id are really identical
+    static QString fullContentHash(const QString &filename);
+
+    //path -> content id of every file seen before, so unchanged files are not read again
+    QHash<QString, CachedPath> readPaths() const;
+
+    void writePaths(const QHash<QString, CachedPath> &paths) const;
+
+    void removePath(const QString &path) const;
+
+    //rows cached by versions that identified videos by path and date are moved to content id of
+    //same file (oldId -> contentId), so they are not processed again. Returns number of videos moved
+    int adoptLegacyIds(const QHash<QString, QString> &contentIds) const;
+
+    //constructor creates a database file if there is none already. Creates tables, or upgrades
+    //those of cache made by older version in place, keeping what is cached
     void createTables() const;
 
     //return true and updates member variables if the video metadata was cached
@@ -50,9 +119,27 @@ public:
     //returns false if id not cached or could not be removed
     bool removeVideo(const QString &id) const;
 
-    void populateMetadatas(const QHash<QString, Video *> _everyVideo) const;
+    void populateMetadatas(const QMultiHash<QString, Video *> &_everyVideo) const;
+
+    void populateCaptures(const QMultiHash<QString, Video *> &_everyVideo, const QVector<int> &percentages) const;
+
+    //save pHash sequence taken every interval seconds
+    void writeTemporal(const QString &id, const int &interval, const QVector<uint64_t> &hashes) const;
+
+    //fill temporal fingerprints of videos that were cached with same interval
+    void populateTemporals(const QMultiHash<QString, Video *> &_everyVideo, const int &interval) const;
+
+    //save audio fingerprint hashes
+    void writeAudio(const QString &id, const QVector<uint32_t> &hashes) const;
+
+    //fill audio fingerprints of cached videos
+    void populateAudio(const QMultiHash<QString, Video *> &_everyVideo) const;
+
+    //save content rectangle (without black bars) of each capture, by capture percent
+    void writeCrops(const QString &id, const QHash<int, QRectF> &crops) const;
 
-    void populateCaptures(const QHash<QString, Video *> _everyVideo, const QVector<int> &percentages) const;
+    //fill content rectangles of cached videos
+    void populateCrops(const QMultiHash<QString, Video *> &_everyVideo) const;
 };
 
 #endif // DB_H
@@ -0,0 +1,461 @@
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QFileInfo>
+#include <QDir>
+#include <QTextStream>
+#include <algorithm>
+#include <omp.h>
+#include "distributed.h"
+#include "snapshot.h"
+#include "scoring.h"
+
+void Distributed::send(QTcpSocket &socket, const QByteArray &message)
+{
+    QByteArray length;
+    QDataStream(&length, QIODevice::WriteOnly) << static_cast<quint32>(message.size());
+    socket.write(length);
+    socket.write(message);
+}
+
+bool Distributed::receive(QTcpSocket &socket, QByteArray &buffer, QByteArray &message)
+{
+    buffer += socket.readAll();
+    if(buffer.size() < static_cast<int>(sizeof(quint32)))
+        return false;
+    quint32 length;
+    QDataStream(buffer) >> length;
+    if(static_cast<quint32>(buffer.size()) - sizeof(quint32) < length)
+        return false;
+    message = buffer.mid(sizeof(quint32), static_cast<int>(length));
+    buffer.remove(0, static_cast<int>(sizeof(quint32) + length));
+    return true;
+}
+
+void Distributed::writePrefs(QDataStream &stream, const Prefs &prefs)
+{
+    stream << static_cast<qint32>(prefs._comparisonMode) << static_cast<qint32>(prefs._thumbnails)
+           << prefs._hashVariants << prefs._fineHash << static_cast<qint32>(prefs._ssimBlockSize)
+           << prefs._thresholdSSIM << static_cast<qint32>(prefs._thresholdPhash)
+           << prefs._thresholdSSIMMax << static_cast<qint32>(prefs._thresholdPhashMax)
+           << static_cast<qint32>(prefs._differentDurationModifier) << static_cast<qint32>(prefs._sameDurationModifier);
+}
+
+void Distributed::readPrefs(QDataStream &stream, Prefs &prefs)
+{
+    qint32 mode, thumbnails, blockSize, thresholdPhash, thresholdPhashMax, different, same;
+    stream >> mode >> thumbnails >> prefs._hashVariants >> prefs._fineHash >> blockSize >> prefs._thresholdSSIM >> thresholdPhash
+           >> prefs._thresholdSSIMMax >> thresholdPhashMax >> different >> same;
+    prefs._comparisonMode = mode;
+    prefs._thumbnails = thumbnails;
+    prefs._ssimBlockSize = blockSize;
+    prefs._thresholdPhash = thresholdPhash;
+    prefs._thresholdPhashMax = thresholdPhashMax;
+    prefs._differentDurationModifier = different;
+    prefs._sameDurationModifier = same;
+}
+
+Coordinator::Coordinator(const Prefs &prefs, const QString &snapshotFile) :
+    _prefs(prefs), _snapshotFile(snapshotFile), _snapshot(snapshotFile),
+    _journal(QStringLiteral("%1/coordinator.journal").arg(Db::cacheFolder()))
+{
+    if(_snapshot.count() == 0)
+        return;
+    _prefs._thumbnails = _snapshot.thumbnails();
+    _prefs._hashVariants = _snapshot.hashVariants();
+    _prefs._fineHash = _snapshot.fineHashes();
+    _snapshot.comparisonSettings(_prefs);               //workers get them with Settings message
+    _prefs._numberOfVideos = _snapshot.count();
+    Video::setPrefs(_prefs);
+    _videos = _snapshot.load(_arena);
+    _snapshotId = Db::fullContentHash(_snapshotFile);
+
+    TileScheduler scheduler(_videos.count(), _tileSize);
+    Tile tile;
+    while(scheduler.next(tile))
+        _tiles << tile;
+    readJournal();
+    for(int tile=0; tile<_tiles.count(); tile++)
+        if(!_finished.contains(tile))
+            _pending << tile;
+
+    connect(&_server, SIGNAL(newConnection()), this, SLOT(acceptWorker()));
+}
+
+bool Coordinator::listen(const quint16 &port)
+{
+    if(_videos.count() < 2)
+    {
+        qCritical().noquote() << "No usable snapshot of a previous search in" << QDir::toNativeSeparators(_snapshotFile);
+        return false;
+    }
+    if(!_server.listen(QHostAddress::Any, port))
+    {
+        qCritical().noquote() << "Cannot listen on port" << port << _server.errorString();
+        return false;
+    }
+    qInfo().noquote() << _videos.count() << "videos," << _tiles.count() << "tiles," << _finished.count()
+                      << "already finished. Waiting for workers on port" << _server.serverPort();
+    if(_pending.isEmpty())
+        finish();
+    return true;
+}
+
+bool Coordinator::inTile(const Distributed::PairMatch &match, const Tile &tile)
+{
+    return match.left >= tile.rowStart && match.left < tile.rowEnd && match.right > match.left &&
+           match.right >= tile.columnStart && match.right < tile.columnEnd;
+}
+
+void Coordinator::readJournal()
+{
+    const QString header = QStringLiteral("vidupe-journal %1 %2 %3").arg(_snapshotId).arg(_tileSize).arg(_videos.count());
+    if(_journal.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        QTextStream in(&_journal);
+        if(in.readLine() == header)                     //journal of same snapshot: continue where it stopped
+        {
+            QVector<Distributed::PairMatch> tileMatches;
+            while(!in.atEnd())
+            {
+                const QStringList fields = in.readLine().split(' ');
+                if(fields.value(0) == QLatin1String("match") && fields.count() == 4)
+                    tileMatches << Distributed::PairMatch{ fields[1].toInt(), fields[2].toInt(), fields[3].toDouble() };
+                else if(fields.value(0) == QLatin1String("done") && fields.count() == 2)
+                {
+                    const int tile = fields[1].toInt();
+                    bool valid = tile >= 0 && tile < _tiles.count();
+                    for(const auto &match : tileMatches)
+                        valid = valid && inTile(match, _tiles[tile]);
+                    if(valid)                           //damaged lines: tile is compared again
+                    {
+                        _finished << tile;
+                        _matches << tileMatches;
+                    }
+                    tileMatches.clear();
+                }
+            }                                           //matches of a tile without done line are compared again
+        }
+        _journal.close();
+    }
+
+    if(_finished.isEmpty())
+    {
+        _journal.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
+        QTextStream(&_journal) << header << '\n';
+    }
+    else
+        _journal.open(QIODevice::Append | QIODevice::Text);
+}
+
+void Coordinator::acceptWorker()
+{
+    while(QTcpSocket *worker = _server.nextPendingConnection())
+    {
+        connect(worker, SIGNAL(readyRead()), this, SLOT(readWorker()));
+        connect(worker, SIGNAL(disconnected()), this, SLOT(dropWorker()));
+        connect(worker, SIGNAL(bytesWritten(qint64)), this, SLOT(sendSnapshot()));
+    }
+}
+
+void Coordinator::readWorker()
+{
+    QTcpSocket *worker = qobject_cast<QTcpSocket *>(sender());
+    QByteArray message;
+    while(worker && Distributed::receive(*worker, _buffers[worker], message))
+    {
+        QDataStream in(message);
+        quint8 type;
+        in >> type;
+
+        if(type == Distributed::Hello)
+        {
+            quint32 version;
+            QString workerSnapshotId;
+            in >> version >> workerSnapshotId;
+            if(version != Distributed::protocolVersion)
+            {
+                worker->disconnectFromHost();
+                return;
+            }
+            const bool download = workerSnapshotId != _snapshotId;
+            QByteArray reply;
+            QDataStream out(&reply, QIODevice::WriteOnly);
+            out << static_cast<quint8>(Distributed::Settings);
+            Distributed::writePrefs(out, _prefs);
+            out << static_cast<qint32>(_videos.count()) << _snapshotId << download;
+            Distributed::send(*worker, reply);
+            if(download)
+            {
+                _snapshotSent[worker] = 0;
+                sendChunk(worker);
+            }
+            qInfo().noquote() << "Worker" << worker->peerAddress().toString() << "connected"
+                              << (download? "(downloading snapshot)" : "");
+        }
+        else if(type == Distributed::Request)
+            assignTile(worker);
+        else if(type == Distributed::Result)
+        {
+            qint32 tile, count;
+            in >> tile >> count;
+            QVector<Distributed::PairMatch> tileMatches;
+            for(int i=0; i<count && !in.atEnd(); i++)
+            {
+                Distributed::PairMatch match;
+                in >> match.left >> match.right >> match.similarity;
+                tileMatches << match;
+            }
+            if(!_assigned[worker].contains(tile))
+                continue;                               //not given to this worker, or was sent twice
+            bool valid = in.status() == QDataStream::Ok && tileMatches.count() == count;
+            for(const auto &match : tileMatches)
+                valid = valid && inTile(match, _tiles[tile]);
+            if(!valid)                                  //buggy or old worker: compare tile elsewhere, drop worker
+            {
+                qWarning().noquote() << "Worker" << worker->peerAddress().toString() << "sent invalid result of tile" << tile;
+                worker->disconnectFromHost();           //dropWorker() gives its tiles to others
+                return;
+            }
+            _assigned[worker].removeAll(tile);
+            if(_finished.contains(tile))
+                continue;                               //was given to another worker too, already counted
+
+            QTextStream journal(&_journal);
+            for(const auto &match : tileMatches)
+                journal << "match " << match.left << ' ' << match.right << ' ' << QString::number(match.similarity, 'g', 10) << '\n';
+            journal << "done " << tile << '\n';
+            journal.flush();
+            _journal.flush();
+            _finished << tile;
+            _matches << tileMatches;
+            qInfo().noquote() << QStringLiteral("%1/%2 tiles finished").arg(_finished.count()).arg(_tiles.count());
+            if(_finished.count() == _tiles.count())
+            {
+                finish();
+                return;
+            }
+        }
+    }
+}
+
+void Coordinator::sendSnapshot()
+{
+    QTcpSocket *worker = qobject_cast<QTcpSocket *>(sender());
+    if(worker)
+        sendChunk(worker);
+}
+
+void Coordinator::sendChunk(QTcpSocket *worker)
+{
+    if(!_snapshotSent.contains(worker) || worker->bytesToWrite() > _chunkSize)
+        return;                                         //not downloading, or enough is still waiting to be sent
+
+    QFile file(_snapshotFile);
+    if(!file.open(QIODevice::ReadOnly) || !file.seek(_snapshotSent[worker]))
+    {
+        worker->disconnectFromHost();
+        return;
+    }
+    const QByteArray chunk = file.read(_chunkSize);
+    QByteArray message;
+    QDataStream out(&message, QIODevice::WriteOnly);
+    if(chunk.isEmpty())
+    {
+        out << static_cast<quint8>(Distributed::SnapshotEnd);
+        _snapshotSent.remove(worker);
+    }
+    else
+    {
+        out << static_cast<quint8>(Distributed::SnapshotChunk) << chunk;
+        _snapshotSent[worker] += chunk.size();
+    }
+    Distributed::send(*worker, message);
+}
+
+void Coordinator::assignTile(QTcpSocket *worker)
+{
+    if(_pending.isEmpty())
+    {
+        if(_finished.count() == _tiles.count())
+        {
+            QByteArray done;
+            QDataStream(&done, QIODevice::WriteOnly) << static_cast<quint8>(Distributed::Done);
+            Distributed::send(*worker, done);
+        }
+        else
+            _waiting << worker;                         //a tile may come back if its worker disconnects
+        return;
+    }
+
+    const int number = _pending.takeFirst();
+    _assigned[worker] << number;
+    const Tile &tile = _tiles[number];
+    QByteArray message;
+    QDataStream(&message, QIODevice::WriteOnly) << static_cast<quint8>(Distributed::TileData) << static_cast<qint32>(number)
+        << static_cast<qint32>(tile.rowStart) << static_cast<qint32>(tile.rowEnd)
+        << static_cast<qint32>(tile.columnStart) << static_cast<qint32>(tile.columnEnd);
+    Distributed::send(*worker, message);
+}
+
+void Coordinator::dropWorker()
+{
+    QTcpSocket *worker = qobject_cast<QTcpSocket *>(sender());
+    if(!worker)
+        return;
+    for(const int tile : _assigned.value(worker))       //unfinished tiles go to the next worker that asks
+        if(!_finished.contains(tile))
+            _pending.prepend(tile);
+    _assigned.remove(worker);
+    _buffers.remove(worker);
+    _snapshotSent.remove(worker);
+    _waiting.remove(worker);
+    worker->deleteLater();
+
+    const QList<QTcpSocket *> waiting = _waiting.values();
+    for(QTcpSocket *other : waiting)
+        if(!_pending.isEmpty())
+        {
+            _waiting.remove(other);
+            assignTile(other);
+        }
+}
+
+void Coordinator::finish()
+{
+    std::sort(_matches.begin(), _matches.end(), [](const Distributed::PairMatch &a, const Distributed::PairMatch &b)
+        { return a.similarity > b.similarity || (a.similarity == b.similarity &&
+                 (a.left < b.left || (a.left == b.left && a.right < b.right))); });
+
+    QFile results(QStringLiteral("%1/matches.tsv").arg(Db::cacheFolder()));
+    if(results.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        QTextStream out(&results);
+        out << "similarity\tleft\tright\n";
+        for(const auto &match : _matches)
+            out << QString::number(match.similarity, 'g', 4) << '\t' << QDir::toNativeSeparators(_videos[match.left]->filename)
+                << '\t' << QDir::toNativeSeparators(_videos[match.right]->filename) << '\n';
+    }
+    qInfo().noquote() << _matches.count() << "matches saved in" << QDir::toNativeSeparators(results.fileName());
+
+    _journal.close();
+    _journal.remove();                                  //next run compares from start
+
+    QByteArray done;
+    QDataStream(&done, QIODevice::WriteOnly) << static_cast<quint8>(Distributed::Done);
+    for(QTcpSocket *worker : _waiting)
+    {
+        Distributed::send(*worker, done);
+        worker->flush();
+    }
+    QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);    //may be before exec()
+}
+
+QByteArray Worker::waitForMessage(QTcpSocket &socket, QByteArray &buffer)
+{
+    QByteArray message;
+    while(!Distributed::receive(socket, buffer, message))
+        if(!socket.waitForReadyRead(_timeout) && socket.state() != QAbstractSocket::ConnectedState)
+            return QByteArray();
+    return message;
+}
+
+int Worker::run(const QString &host, const quint16 &port)
+{
+    const QString snapshotFile = QStringLiteral("%1/worker-snapshot.bin").arg(Db::cacheFolder());
+    QTcpSocket socket;
+    socket.connectToHost(host, port);
+    if(!socket.waitForConnected(_timeout))
+    {
+        qCritical().noquote() << "Cannot connect to" << host << port << socket.errorString();
+        return 1;
+    }
+
+    QByteArray hello;
+    QDataStream(&hello, QIODevice::WriteOnly) << static_cast<quint8>(Distributed::Hello) << Distributed::protocolVersion
+                                              << (QFileInfo::exists(snapshotFile)? Db::fullContentHash(snapshotFile) : QString());
+    Distributed::send(socket, hello);
+
+    QByteArray buffer;
+    QByteArray message = waitForMessage(socket, buffer);
+    QDataStream settings(message);
+    quint8 type = 0;
+    Prefs prefs;
+    qint32 count = 0;
+    QString snapshotId;
+    bool download = false;
+    settings >> type;
+    if(type != Distributed::Settings)
+        return 1;
+    Distributed::readPrefs(settings, prefs);
+    settings >> count >> snapshotId >> download;
+
+    if(download)                                        //kept for next run, coordinator skips sending same one again
+    {
+        QFile file(snapshotFile);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            return 1;
+        for(;;)
+        {
+            message = waitForMessage(socket, buffer);
+            QDataStream in(message);
+            QByteArray chunk;
+            in >> type;
+            if(message.isEmpty() || (type != Distributed::SnapshotChunk && type != Distributed::SnapshotEnd))
+                return 1;
+            if(type == Distributed::SnapshotEnd)
+                break;
+            in >> chunk;
+            file.write(chunk);
+        }
+    }
+
+    prefs._numberOfVideos = count;
+    Video::setPrefs(prefs);
+    const Snapshot snapshot(snapshotFile);              //videos read their hashes from it while comparing
+    VideoArena arena;
+    const QVector<Video *> videos = snapshot.load(arena);
+    if(videos.count() != count)
+    {
+        qCritical().noquote() << "Snapshot has" << videos.count() << "videos, coordinator has" << count;
+        return 1;
+    }
+    qInfo().noquote() << count << "videos loaded, comparing tiles";
+
+    const Scoring scoring(prefs);
+    QByteArray request;
+    QDataStream(&request, QIODevice::WriteOnly) << static_cast<quint8>(Distributed::Request);
+    for(;;)
+    {
+        Distributed::send(socket, request);
+        message = waitForMessage(socket, buffer);
+        QDataStream in(message);
+        in >> type;
+        if(message.isEmpty() || type == Distributed::Done)
+            return message.isEmpty()? 1 : 0;
+        if(type != Distributed::TileData)
+            return 1;
+
+        qint32 number, rowStart, rowEnd, columnStart, columnEnd;
+        in >> number >> rowStart >> rowEnd >> columnStart >> columnEnd;
+        QVector<QVector<Distributed::PairMatch>> perThread(omp_get_max_threads());
+        #pragma omp parallel for schedule(dynamic)
+        for(int i = rowStart; i < rowEnd; i++)
+            for(int j = qMax(i + 1, static_cast<int>(columnStart)); j < columnEnd; j++)
+            {
+                const MatchScore score = scoring.score(videos[i], videos[j]);
+                if(score.match)
+                    perThread[omp_get_thread_num()] << Distributed::PairMatch{ i, j, score.similarity };
+            }
+
+        QByteArray result;
+        QDataStream out(&result, QIODevice::WriteOnly);
+        int matches = 0;
+        for(const auto &threadMatches : perThread)
+            matches += threadMatches.count();
+        out << static_cast<quint8>(Distributed::Result) << number << static_cast<qint32>(matches);
+        for(const auto &threadMatches : perThread)
+            for(const auto &match : threadMatches)
+                out << static_cast<qint32>(match.left) << static_cast<qint32>(match.right) << match.similarity;
+        Distributed::send(socket, result);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QFile>
+#include <QSet>
+#include "video.h"
+#include "tiles.h"
+#include "snapshot.h"
+
+//all pairs comparison spread over processes or machines. Coordinator serves snapshot.bin of last search and hands
+//out tiles of pairs, workers compare them and send matches back. Finished tiles are appended to a journal, so a
+//stopped coordinator continues where it was and tiles of a worker that disconnects are given to another one.
+//Messages are a 32 bit length followed by QDataStream data, first field is the message type
+namespace Distributed
+{
+    enum Message : quint8 { Hello, Settings, SnapshotChunk, SnapshotEnd, Request, TileData, Result, Done };
+
+    static constexpr quint32 protocolVersion = 2;
+
+    struct PairMatch
+    {
+        int left;
+        int right;
+        double similarity;
+    };
+
+    void send(QTcpSocket &socket, const QByteArray &message);
+
+    //comparison settings workers must use, thumbnail mode, hash variants and fine hashes come from snapshot
+    void writePrefs(QDataStream &stream, const Prefs &prefs);
+    void readPrefs(QDataStream &stream, Prefs &prefs);
+
+    //next complete message from socket, buffer keeps bytes of an incomplete one. False if none yet
+    bool receive(QTcpSocket &socket, QByteArray &buffer, QByteArray &message);
+}
+
+class Coordinator : public QObject
+{
+    Q_OBJECT
+
+public:
+    Coordinator(const Prefs &prefs, const QString &snapshotFile);
+
+    //false if snapshot is missing or port is taken
+    bool listen(const quint16 &port);
+
+private slots:
+    void acceptWorker();
+    void readWorker();
+    void dropWorker();
+    void sendSnapshot();                                //next chunk, when previous ones are sent
+
+private:
+    Prefs _prefs;
+    QString _snapshotFile;
+    QString _snapshotId;                                //content id of snapshot, workers that have it skip download
+    const Snapshot _snapshot;                           //mapped as long as _videos point into it
+    VideoArena _arena;
+    QVector<Video *> _videos;                           //only for paths in results, workers load their own
+    QTcpServer _server;
+
+    QVector<Tile> _tiles;
+    QVector<int> _pending;                              //tile numbers not given out yet
+    QHash<QTcpSocket *, QVector<int>> _assigned;        //tiles a worker is comparing now
+    QHash<QTcpSocket *, QByteArray> _buffers;
+    QHash<QTcpSocket *, qint64> _snapshotSent;          //bytes of snapshot sent to workers still downloading it
+    QSet<QTcpSocket *> _waiting;                        //asked for tile when all were given out but not finished
+    QSet<int> _finished;
+    QVector<Distributed::PairMatch> _matches;
+    QFile _journal;
+
+    void readJournal();
+    static bool inTile(const Distributed::PairMatch &match, const Tile &tile);    //tiles are within video count
+    void assignTile(QTcpSocket *worker);
+    void sendChunk(QTcpSocket *worker);
+    void finish();
+
+    static constexpr int _tileSize = 2048;              //videos per side, about two million pairs per message
+    static constexpr int _chunkSize = 4 * 1024 * 1024;
+};
+
+//connects to coordinator and compares tiles until there are none left, returns exit code
+class Worker
+{
+public:
+    static int run(const QString &host, const quint16 &port);
+
+private:
+    static QByteArray waitForMessage(QTcpSocket &socket, QByteArray &buffer);
+
+    static constexpr int _timeout = 600000;
+};
+
+#endif // DISTRIBUTED_H
@@ -0,0 +1,70 @@
+#include "hashindex.h"
+#include "temporal.h"
+#include "video.h"
+
+HashIndex::HashIndex(const QVector<Video *> &videos, const int &maxDistance) :
+    _videos(videos), _maxDistance(maxDistance)
+{
+    const int substrings = qMax(1, _maxDistance + 1);
+    _bruteForce = 64 / substrings < _minSubstringBits;
+    if(_bruteForce)
+        return;
+
+    for(int number=0; number<=substrings; number++)     //spread leftover bits over first substrings
+        _substringStart << number * (64 / substrings) + qMin(number, 64 % substrings);
+
+    _tables.resize(substrings);
+    for(int video=0; video<_videos.count(); video++)
+        for(int slot=0; slot<_videos[video]->hashSlots(); slot++)
+            for(int number=0; number<substrings; number++)
+                _tables[number][substring(_videos[video]->hashAt(slot), number)] << qMakePair(video, slot);
+}
+
+uint64_t HashIndex::substring(const uint64_t &hash, const int &number) const
+{
+    const int bits = _substringStart[number + 1] - _substringStart[number];
+    if(bits == 64)
+        return hash;
+    return hash >> _substringStart[number] & ((1ULL << bits) - 1);
+}
+
+QVector<int> HashIndex::candidates(const int &index) const
+{
+    QVector<int> result;
+    if(_bruteForce)
+    {
+        for(int other=index+1; other<_videos.count(); other++)
+            result << other;
+        return result;
+    }
+
+    const Video *thisVideo = _videos[index];
+    for(int slot=0; slot<thisVideo->hashSlots(); slot++)
+    {
+        const bool thisVariant = slot >= thisVideo->hashCount();
+        const uint64_t thisHash = thisVideo->hashAt(slot);
+        for(int number=0; number<_tables.count(); number++)
+        {
+            const auto bucket = _tables[number].constFind(substring(thisHash, number));
+            if(bucket == _tables[number].cend())
+                continue;
+            for(const auto &entry : bucket.value())
+            {
+                if(entry.first <= index)                //every pair is reported only once
+                    continue;
+                const Video *other = _videos[entry.first];
+                if(thisVariant && entry.second >= other->hashCount())
+                    continue;
+                const uint64_t otherHash = other->hashAt(entry.second);
+                if(thisHash == 0 && otherHash == 0)     //both black, never a match
+                    continue;
+                if(Temporal::hammingDistance(thisHash, otherHash) <= _maxDistance)
+                    result << entry.first;
+            }
+        }
+    }
+
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
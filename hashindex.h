@@ -0,0 +1,35 @@
+#ifndef HASHINDEX_H
+#define HASHINDEX_H
+
+#include <QHash>
+#include <QVector>
+
+class Video;
+
+//multi-index hashing: when 64 bit pHash is split into maxDistance+1 substrings, two hashes
+//within maxDistance bits of each other must have at least one substring exactly the same
+class HashIndex
+{
+public:
+    HashIndex(const QVector<Video *> &videos, const int &maxDistance);
+
+    //videos with larger index than video[index] having any hash within maxDistance of any hash of video[index]
+    //(hash variants included, but a variant is only compared against original hashes)
+    QVector<int> candidates(const int &index) const;
+
+    //false if maxDistance is so large that candidates() returns every later video
+    bool indexed() const { return !_bruteForce; }
+
+private:
+    const QVector<Video *> &_videos;
+    int _maxDistance;
+    bool _bruteForce;                                   //substrings too short to narrow anything down
+    QVector<int> _substringStart;                       //first bit of each substring, last entry is 64
+    QVector<QHash<uint64_t, QVector<QPair<int, int>>>> _tables;    //per substring: value -> (video, hash slot)
+
+    uint64_t substring(const uint64_t &hash, const int &number) const;
+
+    static constexpr int _minSubstringBits = 4;
+};
+
+#endif // HASHINDEX_H
@@ -1,15 +1,109 @@
 #include <QFileDialog>
+#include <QCommandLineParser>
 #include <QtConcurrent/QtConcurrent>
 #include <QScrollBar>
 #include "mainwindow.h"
 #include "comparison.h"
+#include "metrics.h"
+#include "snapshot.h"
+#include "distributed.h"
+#include "capturecodec.h"
 #include <QElapsedTimer>
 #include <QDebug>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    QApplication::setApplicationVersion(APP_VERSION);
+
+    QCommandLineParser parser;                  //servers without display: add -platform offscreen
+    parser.setApplicationDescription(QStringLiteral("Finds duplicate videos. Without options, opens the main window."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    const QCommandLineOption cacheOption(QStringLiteral("cache"),
+        QStringLiteral("Use <file> as cache instead of cache.db in program folder."), QStringLiteral("file"));
+    const QCommandLineOption ingestOption(QStringLiteral("ingest"),
+        QStringLiteral("Find and process videos in <folders> (separated by ;) into cache, then exit without comparing."),
+        QStringLiteral("folders"));
+    const QCommandLineOption mergeOption(QStringLiteral("merge"),
+        QStringLiteral("Add videos cached in <file> (made by --ingest on another machine) to cache, then exit."),
+        QStringLiteral("file"));
+    const QCommandLineOption mapOption(QStringLiteral("map"),
+        QStringLiteral("With --merge: paths starting with <from> are rewritten to start with <to>."), QStringLiteral("from=to"));
+    const QCommandLineOption cleanOption(QStringLiteral("clean"),
+        QStringLiteral("Remove videos not seen for <days> or deleted from cache, then compact it and exit."), QStringLiteral("days"));
+    const QCommandLineOption capturesOption(QStringLiteral("captures"),
+        QStringLiteral("Cache captures as <format>: jpeg (default), gray (smallest and fastest, gray thumbnails) or color. "
+                       "Captures already cached are converted, then exit."), QStringLiteral("format"));
+    const QCommandLineOption coordinateOption(QStringLiteral("coordinate"),
+        QStringLiteral("Compare all pairs of snapshot of last search, with its mode and thresholds, by workers connecting to <port>. "
+                       "Matches are saved in matches.tsv."),
+        QStringLiteral("port"));
+    const QCommandLineOption workOption(QStringLiteral("work"),
+        QStringLiteral("Compare pairs handed out by coordinator at <host:port> until all are done."), QStringLiteral("host:port"));
+    parser.addOptions({ cacheOption, ingestOption, mergeOption, mapOption, cleanOption, capturesOption, coordinateOption, workOption });
+    parser.process(a);
+
+    if(parser.isSet(cacheOption))
+        Db::setCacheFile(QFileInfo(parser.value(cacheOption)).absoluteFilePath());
+    if(parser.isSet(mergeOption))
+    {
+        const QString map = QDir::fromNativeSeparators(parser.value(mapOption));   //paths are cached with / separators
+        const Db cache(QStringLiteral("merge"), nullptr);
+        cache.createTables();
+        const int merged = cache.merge(parser.value(mergeOption), map.section('=', 0, 0), map.section('=', 1));
+        if(merged < 0)
+            qCritical().noquote() << "Cannot open" << parser.value(mergeOption);
+        else
+            qInfo().noquote() << merged << "rows merged into" << QDir::toNativeSeparators(Db::cacheFile());
+        return merged < 0? 1 : 0;
+    }
+    if(parser.isSet(cleanOption))
+    {
+        const int days = parser.value(cleanOption).toInt();
+        if(days <= 0 || !QFileInfo::exists(Db::cacheFile()))
+        {
+            qCritical().noquote() << "Nothing to clean, give number of days and an existing cache";
+            return 1;
+        }
+        const Db cache(QStringLiteral("clean"), nullptr);
+        cache.createTables();
+        const Cleanup cleanup = cache.collectGarbage(days);
+        qInfo().noquote() << QStringLiteral("%1 deleted path(s), %2 video(s) and %3 orphan row(s) removed, %4 MB freed")
+                             .arg(cleanup.paths).arg(cleanup.videos).arg(cleanup.orphans)
+                             .arg(cleanup.bytesFreed / (1024.0 * 1024), 0, 'f', 1);
+        return 0;
+    }
+    if(parser.isSet(capturesOption))
+    {
+        const int format = CaptureCodec::fromName(parser.value(capturesOption));
+        if(format < 0)
+        {
+            qCritical().noquote() << "Unknown capture format" << parser.value(capturesOption);
+            return 1;
+        }
+        const Db cache(QStringLiteral("captures"), nullptr);
+        cache.createTables();
+        qInfo().noquote() << cache.convertCaptures(format) << "capture(s) converted to" << CaptureCodec::name(format);
+        return 0;
+    }
+
+    if(parser.isSet(workOption))
+    {
+        const QString address = parser.value(workOption);
+        return Worker::run(address.section(':', 0, -2), static_cast<quint16>(address.section(':', -1).toUInt()));
+    }
+    if(parser.isSet(coordinateOption))
+    {
+        Coordinator coordinator(Prefs(), QStringLiteral("%1/snapshot.bin").arg(Db::cacheFolder()));
+        if(!coordinator.listen(static_cast<quint16>(parser.value(coordinateOption).toUInt())))
+            return 1;
+        return a.exec();
+    }
+
     MainWindow w;
+    if(parser.isSet(ingestOption))
+        return w.ingest(parser.value(ingestOption));
     w.show();
     return a.exec();
 }
@@ -18,6 +112,7 @@ MainWindow::MainWindow() : ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
     _prefs._mainwPtr = this;
+    qRegisterMetaType<Video *>();                       //Video is not a QObject, needed for queued signals
 
     ui->statusBox->append(QStringLiteral("%1 %2").arg(APP_NAME, APP_VERSION));
     ui->statusBox->append(QStringLiteral("%1").arg(APP_COPYRIGHT).replace("\xEF\xBF\xBD ", QStringLiteral("© "))
@@ -175,38 +270,11 @@ void MainWindow::on_findDuplicates_clicked()
     }
     if(!detectffmpeg())
         return;
+    Metrics::instance().reset(_prefs._metricsTrace);
 
     const QString foldersToSearch = ui->directoryBox->text();   //search only if folder or thumbnail settings have changed
     if(foldersToSearch != _previousRunFolders || _prefs._thumbnails != _previousRunThumbnails)
-    {
-        ui->statusBox->append(QStringLiteral("\nSearching for videos..."));
-        ui->statusBar->setVisible(true);
-
-        for(const auto &video : _videoList)                     //new search: delete videos from previous search
-            delete video;
-        _videoList.clear();
-        _everyVideo.clear();
-
-        const QStringList directories = foldersToSearch.split(QStringLiteral(";"));
-        QString notFound;
-        for(auto directory : directories)               //add all video files from entered paths to list
-        {
-            if(directory.isEmpty())
-                continue;
-            QDir dir = directory.remove(QStringLiteral("\""));
-            if(dir.exists())
-                findVideos(dir);
-            else
-            {
-                addStatusMessage(QStringLiteral("Cannot find folder: %1").arg(QDir::toNativeSeparators(dir.path())));
-                notFound += QStringLiteral("%1 ").arg(QDir::toNativeSeparators(dir.path()));
-            }
-        }
-        if(!notFound.isEmpty())
-            ui->statusBar->showMessage(QStringLiteral("Cannot find folder: %1").arg(notFound));
-
-        processVideos();
-    }
+        searchFolders(foldersToSearch);
 
     if(_videoList.count() > 1)
     {
@@ -226,9 +294,84 @@ void MainWindow::on_findDuplicates_clicked()
         _previousRunThumbnails = _prefs._thumbnails;            //folders to search or thumbnail mode are changed
     }
 
+    saveMetrics();
     ui->findDuplicates->setText(QStringLiteral("Find duplicates"));
 }
 
+void MainWindow::searchFolders(const QString &foldersToSearch)
+{
+    addStatusMessage(QStringLiteral("\nSearching for videos..."));
+    ui->statusBar->setVisible(true);
+
+    _videoList.clear();                                     //new search: delete videos from previous search
+    _everyVideo.clear();
+    _arena.clear();
+    _snapshot.reset();
+
+    Db paths(QStringLiteral("paths"), this);
+    paths.createTables();
+    _prefs._captureFormat = paths.captureFormat();          //before videos are created, they keep a copy of prefs
+    _knownPaths = paths.readPaths();
+    _newPaths.clear();
+    _legacyIds.clear();
+
+    const QStringList directories = foldersToSearch.split(QStringLiteral(";"));
+    QString notFound;
+    for(auto directory : directories)               //add all video files from entered paths to list
+    {
+        if(directory.isEmpty())
+            continue;
+        QDir dir = directory.remove(QStringLiteral("\""));
+        if(dir.exists())
+            findVideos(dir);
+        else
+        {
+            addStatusMessage(QStringLiteral("Cannot find folder: %1").arg(QDir::toNativeSeparators(dir.path())));
+            notFound += QStringLiteral("%1 ").arg(QDir::toNativeSeparators(dir.path()));
+        }
+    }
+    if(!notFound.isEmpty())
+        ui->statusBar->showMessage(QStringLiteral("Cannot find folder: %1").arg(notFound));
+    groupIdenticalFiles();                          //may give files their own id, before paths are written
+    paths.adoptLegacyIds(_legacyIds);
+    paths.writePaths(_newPaths);
+
+    processVideos();
+}
+
+int MainWindow::ingest(const QString &foldersToSearch)
+{
+    _headless = true;                           //status messages go to console
+    if(_extensionList.isEmpty())
+    {
+        addStatusMessage(QStringLiteral("Error: No extensions found in extensions.ini. No video file will be searched."));
+        return 1;
+    }
+    if(!detectffmpeg())
+        return 1;
+    Metrics::instance().reset(_prefs._metricsTrace);
+    searchFolders(foldersToSearch);
+    saveMetrics();
+    return 0;
+}
+
+void MainWindow::saveMetrics() const
+{
+    const QString summary = Metrics::instance().summary();
+    if(summary.isEmpty())                       //nothing was searched or compared
+        return;
+    addStatusMessage(QStringLiteral("\n%1").arg(summary));
+
+    QFile json(QStringLiteral("%1/metrics.json").arg(Db::cacheFolder()));
+    if(json.open(QIODevice::WriteOnly))
+        json.write(Metrics::instance().toJson());
+
+    const QByteArray events = Metrics::instance().toTrace();
+    QFile trace(QStringLiteral("%1/trace.json").arg(Db::cacheFolder()));
+    if(!events.isEmpty() && trace.open(QIODevice::WriteOnly))
+        trace.write(events);
+}
+
 void MainWindow::findVideos(QDir &dir)
 {
     dir.setNameFilters(_extensionList);
@@ -242,20 +385,28 @@ void MainWindow::findVideos(QDir &dir)
         const QFileInfo fileInfo(filename);
 
         const QDateTime dateMod = fileInfo.lastModified();
-        Video *video = new Video(_prefs, filename, dateMod);
-        const QString uniqueId = video->id;
-
-//        bool duplicate = false;                 //don't want duplicates of same file
-        if(!_everyVideo.contains(uniqueId)){
-            _everyVideo[uniqueId] = video;
+        CachedPath &known = _knownPaths[filename];
+        if(known.id.isEmpty() || known.size != fileInfo.size() || known.modified != dateMod)
+        {                                       //new or changed file: read a few chunks of it
+            const bool pathWasKnown = !known.id.isEmpty();
+            const QString legacyId = Db::uniqueId(filename, dateMod, "");
+            known.size = fileInfo.size();
+            known.modified = dateMod;
+            known.id = Db::contentId(filename);
+            if(known.id.isEmpty())              //unreadable, fall back to path and date
+                known.id = legacyId;
+            else if(!pathWasKnown)              //may be cached by older version under path and date
+                _legacyIds[legacyId] = known.id;
+            _newPaths[filename] = known;
         }
-//        for(const auto &alreadyAddedFile : _everyVideo.keys())
-//            if(uniqueId.toLower() == alreadyAddedFile.toLower())
-//            {
-//                duplicate = true;
-//                break;
-//            }
-//        if(!duplicate)
+        const QString uniqueId = known.id;
+
+        bool duplicate = false;                 //same file found through overlapping folders is only added once
+        for(const Video *video : _everyVideo.values(uniqueId))
+            if(video->filename == filename)
+                duplicate = true;
+        if(!duplicate)
+            _everyVideo.insert(uniqueId, _arena.create(filename, dateMod, uniqueId));
 
 
         ui->statusBar->showMessage(QDir::toNativeSeparators(filename), 10);
@@ -266,7 +417,15 @@ void MainWindow::findVideos(QDir &dir)
 void MainWindow::processVideos()
 {
     _prefs._numberOfVideos = _everyVideo.count();
-    ui->statusBox->append(QStringLiteral("Found %1 video file(s):").arg(_prefs._numberOfVideos));
+    addStatusMessage(QStringLiteral("Found %1 video file(s):").arg(_prefs._numberOfVideos));
+    if(_prefs._numberOfVideos > _hugeAmountVideos && !_prefs._memoryLean)   //save memory to avoid crash due to 32 bit limit
+    {
+        const QSignalBlocker blocker(ui->memoryLeanCheckBox);
+        ui->memoryLeanCheckBox->setChecked(true);
+        _prefs._memoryLean = true;
+        addStatusMessage(QStringLiteral("Low memory mode turned on for this many videos"));
+    }
+    Video::setPrefs(_prefs);
     if(_prefs._numberOfVideos > 0)
     {
         ui->selectThumbnails->setDisabled(true);
@@ -281,23 +440,50 @@ void MainWindow::processVideos()
     }
     else return;
 
-    Db setup("main",  this);
-    setup.createTables();
+    QSet<Video *> copies;
+    for(const auto &group : _identicalCopies)
+        for(Video *copy : group)
+            copies << copy;
+
     QElapsedTimer timer;
     timer.start();
-    setup.populateMetadatas(_everyVideo);
+    const QMultiHash<QString, Video *> toProcess = loadSnapshot(copies);
+    const int fromSnapshot = _videoList.count();
+    qDebug() << "loadSnapshot took" << timer.elapsed() << "ms";
+    timer.restart();
+
+    Db setup("main",  this);
+    setup.createTables();
+    setup.populateMetadatas(toProcess);
     qDebug() << "populateMetadatas took" << timer.elapsed() << "ms";
     Thumbnail thumb(_prefs._thumbnails);
     timer.restart();
 
-    setup.populateCaptures(_everyVideo, thumb.percentages());
+    setup.populateCaptures(toProcess, thumb.percentages());
     qDebug() << "populateCaptures took" << timer.elapsed() << "ms";
     timer.restart();
 
+    setup.populateCrops(toProcess);
+    qDebug() << "populateCrops took" << timer.elapsed() << "ms";
+    timer.restart();
+
+    if(_prefs._temporal)
+    {
+        setup.populateTemporals(toProcess, _prefs._temporalInterval);
+        qDebug() << "populateTemporals took" << timer.elapsed() << "ms";
+        timer.restart();
+    }
+    if(_prefs._audio)
+    {
+        setup.populateAudio(toProcess);
+        qDebug() << "populateAudio took" << timer.elapsed() << "ms";
+        timer.restart();
+    }
+
 //Do batch cache retrieval here eventually
     QThreadPool threadPool;
 
-    for(const auto &videoTask : _everyVideo.values())
+    for(const auto &video : toProcess)              //identical copies are not in it, they get features of their original
     {
         if(_userPressedStop)
         {
@@ -307,13 +493,18 @@ void MainWindow::processVideos()
         while(threadPool.activeThreadCount() == threadPool.maxThreadCount())
             QApplication::processEvents();          //avoid blocking signals in event loop
 
-        //auto *videoTask = _everyVideo[filename];
-        videoTask->setAutoDelete(false);
-        threadPool.start(videoTask);
+        threadPool.start(new VideoTask(video, this));   //task is deleted by thread pool when done
     }
     threadPool.waitForDone();
     QApplication::processEvents();                  //process signals from last threads
     qDebug() << "individual video setup took" << timer.elapsed() << "ms";
+    if(!_userPressedStop && _videoList.count() > fromSnapshot)     //unchanged if every video came from it
+    {
+        for(Video *video : _videoList)              //mapped file can't be replaced on Windows
+            video->detachHashes();
+        _snapshot.reset();
+        Snapshot::write(QStringLiteral("%1/snapshot.bin").arg(Db::cacheFolder()), _videoList, _prefs);
+    }
     ui->selectThumbnails->setDisabled(false);
     ui->processedFiles->setVisible(false);
     ui->progressBar->setVisible(false);
@@ -340,6 +531,8 @@ void MainWindow::videoSummary()
 
 void MainWindow::addStatusMessage(const QString &message) const
 {
+    if(_headless)
+        qInfo().noquote() << message;
     ui->statusBox->append(message);
     ui->statusBox->repaint();
 }
@@ -350,6 +543,12 @@ void MainWindow::addVideo(Video *addMe)
     ui->progressBar->setValue(ui->progressBar->value() + 1);
     ui->processedFiles->setText(QStringLiteral("%1/%2").arg(ui->progressBar->value()).arg(ui->progressBar->maximum()));
     _videoList << addMe;
+
+    for(Video *copy : _identicalCopies.value(addMe))
+    {
+        copy->copyFeatures(*addMe);
+        addVideo(copy);
+    }
 }
 
 void MainWindow::removeVideo(Video *deleteMe)
@@ -359,5 +558,91 @@ void MainWindow::removeVideo(Video *deleteMe)
     ui->progressBar->setValue(ui->progressBar->value() + 1);
     ui->processedFiles->setText(QStringLiteral("%1/%2").arg(ui->progressBar->value()).arg(ui->progressBar->maximum()));
     _rejectedVideos << QDir::toNativeSeparators(deleteMe->filename);
-    delete deleteMe;
+
+    for(Video *copy : _identicalCopies.value(deleteMe))
+        removeVideo(copy);
+}
+
+QMultiHash<QString, Video *> MainWindow::loadSnapshot(const QSet<Video *> &copies)
+{
+    QMultiHash<QString, Video *> toProcess;
+    _snapshot = std::make_unique<Snapshot>(QStringLiteral("%1/snapshot.bin").arg(Db::cacheFolder()));
+    const Snapshot &snapshot = *_snapshot;
+    const bool usable = snapshot.usable(_prefs) && !_prefs._temporal && !_prefs._audio;  //fingerprints are not in it
+    QStringList loaded;
+    for(auto video=_everyVideo.cbegin(); video!=_everyVideo.cend(); video++)
+    {
+        Video *loadMe = video.value();
+        if(copies.contains(loadMe))                 //filled when the one they are identical to is added
+            continue;
+        if(usable && snapshot.fill(*loadMe) &&
+           loadMe->size >= _prefs._minSizeBytes && loadMe->duration >= _prefs._minTimeMs)
+        {
+            addVideo(loadMe);
+            loaded << video.key();
+        }
+        else
+            toProcess.insert(video.key(), loadMe);
+    }
+    if(loaded.isEmpty())
+        return toProcess;
+    Db(QStringLiteral("snapshot"), this).touch(loaded);     //cache rows were not read, keep them from expiring
+    addStatusMessage(QStringLiteral("%1 video(s) loaded from snapshot of previous search").arg(loaded.count()));
+    return toProcess;
+}
+
+void MainWindow::groupIdenticalFiles()
+{
+    _identicalCopies.clear();
+    QVector<QPair<Video *, QString>> hashes;            //same content id is only a hint: whole files are compared
+    for(const auto &id : _everyVideo.uniqueKeys())
+        if(_everyVideo.count(id) > 1)
+            for(Video *video : _everyVideo.values(id))
+                hashes << qMakePair(video, QString());
+    QtConcurrent::blockingMap(hashes, [](QPair<Video *, QString> &entry)   //reading whole files is slow
+                              { entry.second = Db::fullContentHash(entry.first->filename); });
+    QHash<Video *, QString> fullHashes;
+    for(const auto &entry : hashes)
+        fullHashes[entry.first] = entry.second;
+
+    int copies = 0;
+    for(const auto &id : _everyVideo.uniqueKeys())      //same size and sampled chunks of content
+    {
+        const QList<Video *> sameId = _everyVideo.values(id);
+        if(sameId.count() < 2)
+            continue;
+
+        QHash<QString, QVector<Video *>> groups;
+        for(Video *video : sameId)
+            groups[fullHashes.value(video)] << video;
+        if(groups.count() > 1)                          //different files sharing content id must not share cache rows
+            for(auto group=groups.cbegin(); group!=groups.cend(); group++)
+                for(Video *video : group.value())
+                {
+                    _everyVideo.remove(id, video);
+                    video->id = group.key();            //full hash, or path of an unreadable file
+                    _everyVideo.insert(video->id, video);
+
+                    CachedPath &known = _knownPaths[video->filename];     //kept, so next search needs no full hash
+                    known.id = video->id;
+                    _newPaths[video->filename] = known;
+                    const QString legacyId = Db::uniqueId(video->filename, video->modified, "");
+                    if(_legacyIds.contains(legacyId))
+                        _legacyIds[legacyId] = video->id;
+                }
+        for(const auto &group : groups)
+        {
+            if(group.count() < 2)
+                continue;
+            QStringList filenames;
+            for(const Video *video : group)
+                filenames << QDir::toNativeSeparators(video->filename);
+            addStatusMessage(QStringLiteral("Identical files:\n  %1").arg(filenames.join(QStringLiteral("\n  "))));
+            _identicalCopies[group.first()] = group.mid(1);
+            copies += group.count() - 1;
+        }
+    }
+    if(copies)
+        addStatusMessage(QStringLiteral("%1 identical cop%2 found, not processed separately")
+                         .arg(copies).arg(copies == 1? QStringLiteral("y") : QStringLiteral("ies")));
 }
@@ -3,8 +3,10 @@
 
 #include <QDragEnterEvent>
 #include <QMimeData>
+#include <QSet>
 #include "ui_mainwindow.h"
 #include "video.h"
+#include "snapshot.h"
 
 namespace Ui { class MainWindow; }
 
@@ -16,19 +18,31 @@ public:
     MainWindow();
     ~MainWindow() { deleteTemporaryFiles(); delete ui; }
 
+    //search and process folders into cache and snapshot without showing window or comparing, returns exit code
+    int ingest(const QString &foldersToSearch);
+
 private:
     Ui::MainWindow *ui;
 
+    VideoArena _arena;                                  //owns every Video, _videoList and _everyVideo point into it
+    std::unique_ptr<Snapshot> _snapshot;                //of previous search, videos loaded from it read hashes in place
     QVector<Video *> _videoList;
-    QHash<QString, Video *> _everyVideo;
+    QMultiHash<QString, Video *> _everyVideo;           //by content id, identical copies share one
+    QHash<QString, CachedPath> _knownPaths;             //path -> content id, from cache and this search
+    QHash<QString, CachedPath> _newPaths;               //paths whose content id was computed in this search
+    QHash<QString, QString> _legacyIds;                 //path and date id of older versions -> content id, of new paths
+    QHash<Video *, QVector<Video *>> _identicalCopies;  //processed file -> byte identical files that take its features
     QStringList _rejectedVideos;
     QStringList _extensionList;
 
     Prefs _prefs;
     bool _userPressedStop = false;
+    bool _headless = false;
     QString _previousRunFolders = QStringLiteral("");
     int _previousRunThumbnails = -1;
 
+    static constexpr int _hugeAmountVideos = 200000;    //more videos than this are processed in low memory mode
+
 private slots:
     void deleteTemporaryFiles() const;
     void closeEvent(QCloseEvent *event) { Q_UNUSED (event) _userPressedStop = true; }
@@ -41,6 +55,14 @@ private slots:
     void setComparisonMode(const int &mode) { if(mode == _prefs._PHASH) ui->selectPhash->click(); else ui->selectSSIM->click(); ui->directoryBox->setFocus(); }
     void on_selectThumbnails_activated(const int &index) { ui->directoryBox->setFocus(); _prefs._thumbnails = index;
                                                            if(_prefs._thumbnails == cutEnds) ui->differentDurationCombo->setCurrentIndex(0); }
+    void on_temporalCheckBox_toggled(const bool &checked) { _prefs._temporal = checked; _previousRunFolders.clear();
+                                                            ui->directoryBox->setFocus(); }
+    void on_audioCheckBox_toggled(const bool &checked) { _prefs._audio = checked; _previousRunFolders.clear();
+                                                         ui->directoryBox->setFocus(); }
+    void on_variantsCheckBox_toggled(const bool &checked) { _prefs._hashVariants = checked; _previousRunFolders.clear();
+                                                            ui->directoryBox->setFocus(); }
+    void on_memoryLeanCheckBox_toggled(const bool &checked) { _prefs._memoryLean = checked; _previousRunFolders.clear();
+                                                              ui->directoryBox->setFocus(); }
     void on_selectPhash_clicked(const bool &checked) { if(checked) _prefs._comparisonMode = _prefs._PHASH; ui->directoryBox->setFocus(); }
     void on_selectSSIM_clicked(const bool &checked) { if(checked) _prefs._comparisonMode = _prefs._SSIM; ui->directoryBox->setFocus(); }
     void on_blocksizeCombo_activated(const int &index) { _prefs._ssimBlockSize = static_cast<int>(pow(2, index+1)); ui->directoryBox->setFocus(); }
@@ -53,6 +75,7 @@ private slots:
     void on_browseFolders_clicked() const;
     void on_directoryBox_returnPressed() { on_findDuplicates_clicked(); }
     void on_findDuplicates_clicked();
+    void searchFolders(const QString &foldersToSearch);
     void findVideos(QDir &dir);
     void processVideos();
     void videoSummary();
@@ -60,6 +83,9 @@ private slots:
     void addStatusMessage(const QString &message) const;
     void addVideo(Video *addMe);
     void removeVideo(Video *deleteMe);
+    void groupIdenticalFiles();
+    QMultiHash<QString, Video *> loadSnapshot(const QSet<Video *> &copies);
+    void saveMetrics() const;
 };
 
 #endif // MAINWINDOW_H
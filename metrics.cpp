@@ -0,0 +1,146 @@
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include "metrics.h"
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::reset(const bool &trace)
+{
+    QMutexLocker lock(&_mutex);
+    _trace = trace;
+    _counters.clear();
+    _histograms.clear();
+    _events.clear();
+    _clock.restart();
+}
+
+void Metrics::count(const char *counter, const int64_t &amount)
+{
+    QMutexLocker lock(&_mutex);
+    _counters[QByteArray(counter)] += amount;
+}
+
+void Metrics::record(const char *stage, const int64_t &startUs, const int64_t &durationUs)
+{
+    QMutexLocker lock(&_mutex);
+    _histograms[QByteArray(stage)].add(durationUs);
+    if(_trace && _events.count() < _maxEvents)
+        _events << TraceEvent{ QByteArray(stage), startUs, durationUs, reinterpret_cast<quintptr>(QThread::currentThreadId()) };
+}
+
+void Metrics::Histogram::add(const int64_t &durationUs)
+{
+    minUs = count == 0? durationUs : qMin(minUs, durationUs);
+    maxUs = qMax(maxUs, durationUs);
+    count++;
+    totalUs += durationUs;
+
+    int bucket = 0;
+    for(int64_t remaining=durationUs; remaining>0 && bucket<31; remaining>>=1)
+        bucket++;
+    buckets[bucket]++;
+}
+
+int64_t Metrics::Histogram::percentileUs(const double &percentile) const
+{
+    const int64_t wanted = static_cast<int64_t>(count * percentile);
+    int64_t seen = 0;
+    for(int bucket=0; bucket<32; bucket++)
+    {
+        seen += buckets[bucket];
+        if(seen > wanted)
+            return qMin(maxUs, (static_cast<int64_t>(1) << bucket) - 1);
+    }
+    return maxUs;
+}
+
+QString Metrics::summary() const
+{
+    QMutexLocker lock(&_mutex);
+    if(_histograms.isEmpty() && _counters.isEmpty())
+        return QString();
+    QString text = QStringLiteral("Stage timings (count, total, median, 95%):");
+    QList<QByteArray> stages = _histograms.keys();
+    std::sort(stages.begin(), stages.end());
+    for(const auto &stage : stages)
+    {
+        const Histogram &histogram = _histograms[stage];
+        text += QStringLiteral("\n  %1: %2, %3 s, %4 ms, %5 ms").arg(QString(stage)).arg(histogram.count)
+                .arg(histogram.totalUs / 1e6, 0, 'f', 2)
+                .arg(histogram.percentileUs(0.5) / 1e3, 0, 'f', 1)
+                .arg(histogram.percentileUs(0.95) / 1e3, 0, 'f', 1);
+    }
+
+    QList<QByteArray> counters = _counters.keys();
+    std::sort(counters.begin(), counters.end());
+    QStringList values;
+    for(const auto &counter : counters)
+        values << QStringLiteral("%1 %2").arg(QString(counter)).arg(_counters[counter]);
+    if(!values.isEmpty())
+        text += QStringLiteral("\nCounters: %1").arg(values.join(QStringLiteral(", ")));
+    return text;
+}
+
+QByteArray Metrics::toJson() const
+{
+    QMutexLocker lock(&_mutex);
+    QJsonObject counters;
+    for(auto counter=_counters.cbegin(); counter!=_counters.cend(); counter++)
+        counters.insert(QString(counter.key()), static_cast<qint64>(counter.value()));
+
+    QJsonObject histograms;
+    for(auto histogram=_histograms.cbegin(); histogram!=_histograms.cend(); histogram++)
+    {
+        const Histogram &h = histogram.value();
+        QJsonArray buckets;
+        for(const auto bucket : h.buckets)
+            buckets << static_cast<qint64>(bucket);
+        QJsonObject stage;
+        stage.insert(QStringLiteral("count"), static_cast<qint64>(h.count));
+        stage.insert(QStringLiteral("total_us"), static_cast<qint64>(h.totalUs));
+        stage.insert(QStringLiteral("min_us"), static_cast<qint64>(h.minUs));
+        stage.insert(QStringLiteral("max_us"), static_cast<qint64>(h.maxUs));
+        stage.insert(QStringLiteral("p50_us"), static_cast<qint64>(h.percentileUs(0.5)));
+        stage.insert(QStringLiteral("p95_us"), static_cast<qint64>(h.percentileUs(0.95)));
+        stage.insert(QStringLiteral("log2_us_buckets"), buckets);
+        histograms.insert(QString(histogram.key()), stage);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("elapsed_us"), static_cast<qint64>(_clock.nsecsElapsed() / 1000));
+    root.insert(QStringLiteral("counters"), counters);
+    root.insert(QStringLiteral("histograms"), histograms);
+    return QJsonDocument(root).toJson();
+}
+
+QByteArray Metrics::toTrace() const
+{
+    QMutexLocker lock(&_mutex);
+    if(!_trace)
+        return QByteArray();
+
+    QHash<quintptr, int> threads;                   //small numbers are easier to read than thread handles
+    QJsonArray events;
+    for(const auto &event : _events)
+    {
+        if(!threads.contains(event.thread))
+            threads.insert(event.thread, threads.count() + 1);
+        QJsonObject json;
+        json.insert(QStringLiteral("name"), QString(event.name));
+        json.insert(QStringLiteral("ph"), QStringLiteral("X"));         //complete event: start and duration
+        json.insert(QStringLiteral("ts"), static_cast<qint64>(event.startUs));
+        json.insert(QStringLiteral("dur"), static_cast<qint64>(event.durationUs));
+        json.insert(QStringLiteral("pid"), 1);
+        json.insert(QStringLiteral("tid"), threads.value(event.thread));
+        events << json;
+    }
+    QJsonObject root;
+    root.insert(QStringLiteral("traceEvents"), events);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,80 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+#include <QElapsedTimer>
+
+//counters and latency histograms of processing stages, shared by all threads. Collected for every search,
+//shown as summary in status box and saved as json. Trace events for chrome://tracing are only kept if enabled
+class Metrics
+{
+public:
+    static Metrics &instance();
+
+    void reset(const bool &trace);
+
+    void count(const char *counter, const int64_t &amount = 1);
+
+    //duration of one stage, startUs is time from reset() (only used for trace)
+    void record(const char *stage, const int64_t &startUs, const int64_t &durationUs);
+
+    int64_t nowUs() const { return _clock.nsecsElapsed() / 1000; }
+
+    //one line per stage and a line of counters, for status box
+    QString summary() const;
+
+    QByteArray toJson() const;
+
+    //chrome trace event format, empty if tracing was not enabled
+    QByteArray toTrace() const;
+
+private:
+    Metrics() { _clock.start(); }
+
+    struct Histogram
+    {
+        int64_t count = 0;
+        int64_t totalUs = 0;
+        int64_t minUs = 0;
+        int64_t maxUs = 0;
+        int64_t buckets[32] = {};       //bucket n: durations of [2^(n-1), 2^n) microseconds
+
+        void add(const int64_t &durationUs);
+        int64_t percentileUs(const double &percentile) const;   //upper bound of bucket holding it
+    };
+
+    struct TraceEvent
+    {
+        QByteArray name;
+        int64_t startUs;
+        int64_t durationUs;
+        quintptr thread;
+    };
+
+    mutable QMutex _mutex;
+    QElapsedTimer _clock;
+    bool _trace = false;
+    QHash<QByteArray, int64_t> _counters;
+    QHash<QByteArray, Histogram> _histograms;
+    QVector<TraceEvent> _events;
+
+    static constexpr int _maxEvents = 1000000;      //about 50 MB of trace, later events are dropped
+};
+
+//records time from construction to end of scope as one occurrence of stage
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char *stage) : _stage(stage), _startUs(Metrics::instance().nowUs()) { }
+    ~ScopedTimer() { Metrics::instance().record(_stage, _startUs, Metrics::instance().nowUs() - _startUs); }
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    const char *_stage;
+    const int64_t _startUs;
+};
+
+#endif // METRICS_H
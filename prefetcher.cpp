@@ -0,0 +1,125 @@
+#include <QtConcurrent/QtConcurrent>
+#include "prefetcher.h"
+#include "video.h"
+#include "db.h"
+
+Prefetcher::Prefetcher(const int &maxThumbnails) : _images(maxThumbnails)
+{
+    _pool.setMaxThreadCount(1);             //one thread is enough to stay ahead of the user, keep the cpu for others
+    _pool.setExpiryTimeout(-1);             //same thread all the time, cache connection belongs to it
+}
+
+Prefetcher::~Prefetcher()
+{
+    _generation.fetchAndAddOrdered(1);
+    QtConcurrent::run(&_pool, [this]() { _cache.reset(); });      //connection is closed by thread that opened it
+    _pool.waitForDone();
+}
+
+void Prefetcher::prefetch(const QVector<const Video *> &videos, const QSize &size)
+{
+    const int generation = _generation.fetchAndAddOrdered(1) + 1;
+    QtConcurrent::run(&_pool, [this, videos, size, generation]()
+    {
+        for(const Video *video : videos)
+        {
+            if(_generation.loadAcquire() != generation)     //user moved on, newer request is waiting
+                return;
+            fetch(video, size, generation);
+        }
+    });
+}
+
+void Prefetcher::fetch(const Video *video, const QSize &size, const int &generation)
+{
+    {
+        QMutexLocker lock(&_mutex);
+        const PrefetchedImage *image = _images.object(video);
+        if(_exists.contains(video) && image && image->scaled.size() == image->decoded.size().scaled(size, Qt::KeepAspectRatio))
+            return;
+    }
+
+    const bool exists = QFileInfo::exists(video->filename);
+    auto *image = new PrefetchedImage;
+    image->decoded = decode(video);
+    image->scaled = image->decoded.scaled(size, Qt::KeepAspectRatio);
+
+    QMutexLocker lock(&_mutex);
+    if(_generation.loadAcquire() == generation)     //forget() was not called while this was running
+        _exists[video] = exists;
+    _images.insert(video, image);
+}
+
+QImage Prefetcher::thumbnail(const Video *video, const QSize &size)
+{
+    {
+        QMutexLocker lock(&_mutex);
+        PrefetchedImage *image = _images.object(video);
+        if(image)
+        {
+            if(image->scaled.size() != image->decoded.size().scaled(size, Qt::KeepAspectRatio))
+                image->scaled = image->decoded.scaled(size, Qt::KeepAspectRatio);     //window was resized
+            return image->scaled;
+        }
+    }
+
+    if(video->thumbnail.isEmpty())          //memory lean mode: read from cache in background, placeholder until then
+    {
+        const int generation = _generation.loadAcquire();
+        QtConcurrent::run(&_pool, [this, video, size, generation]()
+        {
+            fetch(video, size, generation);
+            emit thumbnailLoaded();
+        });
+        return QImage();
+    }
+
+    auto *image = new PrefetchedImage;
+    image->decoded = decodeKept(video);
+    image->scaled = image->decoded.scaled(size, Qt::KeepAspectRatio);
+    const QImage scaled = image->scaled;
+
+    QMutexLocker lock(&_mutex);
+    _images.insert(video, image);
+    return scaled;
+}
+
+bool Prefetcher::exists(const Video *video)
+{
+    {
+        QMutexLocker lock(&_mutex);
+        const auto cached = _exists.constFind(video);
+        if(cached != _exists.cend())
+            return cached.value();
+    }
+
+    const bool exists = QFileInfo::exists(video->filename);
+    QMutexLocker lock(&_mutex);
+    _exists[video] = exists;
+    return exists;
+}
+
+void Prefetcher::forget(const Video *video)
+{
+    QMutexLocker lock(&_mutex);
+    _generation.fetchAndAddOrdered(1);      //running request could store stale result after this, stop it
+    _exists.remove(video);
+}
+
+QImage Prefetcher::decode(const Video *video)
+{
+    if(!video->thumbnail.isEmpty())
+        return decodeKept(video);
+    if(!_cache)                             //memory lean mode: thumbnail was not kept, read it from cache
+        _cache = std::make_unique<Db>(QStringLiteral("prefetch_%1").arg(reinterpret_cast<quintptr>(this)), nullptr);
+    return video->loadThumbnail(*_cache);
+}
+
+QImage Prefetcher::decodeKept(const Video *video)
+{
+    QByteArray jpeg = video->thumbnail;
+    QBuffer pixels(&jpeg);
+    QImage image;
+    image.load(&pixels, QByteArrayLiteral("JPG"));
+    return image;
+}
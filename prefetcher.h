@@ -0,0 +1,60 @@
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <memory>
+
+class Video;
+class Db;
+
+//decodes, scales and stats videos of upcoming pairs in a background thread, so comparison window never waits.
+//Thumbnails that are not kept in memory (memory lean mode) are only read from cache by that thread, with one
+//connection it keeps open, so GUI thread never waits for cache or ffmpeg
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Prefetcher(const int &maxThumbnails);
+    ~Prefetcher();
+
+    //replace any unfinished request with these videos, in order of importance
+    void prefetch(const QVector<const Video *> &videos, const QSize &size);
+
+    //thumbnail scaled to fit size, decoded right away if it was not prefetched. If it must be read from cache,
+    //returns null image and emits thumbnailLoaded() when it is ready
+    QImage thumbnail(const Video *video, const QSize &size);
+
+    //cached result of QFileInfo::exists(), which is slow on network shares
+    bool exists(const Video *video);
+
+    //file was deleted or moved by user, stat it again next time
+    void forget(const Video *video);
+
+signals:
+    void thumbnailLoaded() const;           //from prefetch thread, a thumbnail() that returned null can be asked again
+
+private:
+    struct PrefetchedImage
+    {
+        QImage decoded;
+        QImage scaled;
+    };
+
+    QMutex _mutex;
+    QCache<const Video *, PrefetchedImage> _images;
+    QHash<const Video *, bool> _exists;
+    QThreadPool _pool;
+    QAtomicInt _generation;                 //increased by every request, running older request stops early
+    std::unique_ptr<Db> _cache;             //only used (and destroyed) by prefetch thread
+
+    static QImage decodeKept(const Video *video);  //thumbnail kept in memory, fast enough for GUI thread
+    QImage decode(const Video *video);             //prefetch thread only
+    void fetch(const Video *video, const QSize &size, const int &generation);
+};
+
+#endif // PREFETCHER_H
@@ -27,6 +27,20 @@ public:
     int _cacheLoadPageSize = 300;
     int _minSizeBytes = 52428800;
     int _minTimeMs = 300000;
+
+    bool _temporal = false;                     //dense pHash sequence for finding trimmed, split or joined videos
+    int _temporalInterval = 5;                  //seconds between frames of temporal fingerprint
+    int _temporalMinFrames = 6;                 //aligned frames needed before two sequences are considered a match
+
+    bool _audio = false;                        //spectral peak hashes of a short audio window
+    bool _audioPrefilter = true;                //only compare captures of videos with similar audio (if both have it)
+    double _audioMatchRatio = 0.3;              //share of audio hashes that makes a match even if captures differ
+
+    bool _memoryLean = false;                   //GUI thumbnails are read from cache when shown instead of kept in memory
+    bool _hashVariants = false;                 //also hash flipped and rotated captures
+    bool _fineHash = false;                     //pHash matches must also match by 256 bit hash (pHash mode only)
+    bool _metricsTrace = false;                 //also save every timed stage as trace.json, for chrome://tracing
+    int _captureFormat = 0;                     //how new captures are cached (CaptureCodec::Format), setting of cache
 };
 
 #endif // PREFS_H
@@ -0,0 +1,102 @@
+#include "scoring.h"
+#include "temporal.h"
+#include "video.h"
+
+int Scoring::durationModifier(const Video *left, const Video *right) const
+{
+    if(qAbs(left->duration - right->duration) <= 1000)
+        return 0 + _prefs._sameDurationModifier;                //lower distance if both durations within 1s
+    return 0 - _prefs._differentDurationModifier;               //raise distance if both durations differ 1s
+}
+
+int Scoring::maxHashDistance() const
+{
+    int threshold = _prefs._thresholdPhash;                 //ssim is only calculated if pHash is close enough
+    if(_prefs._comparisonMode == _prefs._SSIM)
+        threshold = qMax(_prefs._thresholdPhash, 44);
+    const int bestModifier = qMax(_prefs._sameDurationModifier, 0 - _prefs._differentDurationModifier);
+    return qBound(0, 64 - threshold + bestModifier, 64);
+}
+
+int Scoring::phashSimilarity(const Video *left, const Video *right, const int &leftHash, const int &rightHash) const
+{
+    if(left->hashAt(leftHash) == 0 && right->hashAt(rightHash) == 0)
+        return 0;
+
+    const int distance = Temporal::hammingDistance(left->hashAt(leftHash), right->hashAt(rightHash));
+    return qMin(64 - distance + durationModifier(left, right), 64);
+}
+
+bool Scoring::fineHashAgrees(const uint64_t *left, const uint64_t *right, const int &durationModifier) const
+{
+    if(!_prefs._fineHash)
+        return true;
+    int distance = 0;
+    for(int word=0; word<4; word++)
+        distance += Temporal::hammingDistance(left[word], right[word]);
+    if(distance == 0)                               //also when neither has one (snapshot or cache of other settings)
+        return true;
+    const int sameBitsOf64 = 64 - qRound(distance / 4.0);      //scaled so same threshold applies to both hashes
+    return qMin(sameBitsOf64 + durationModifier, 64) >= _prefs._thresholdPhash;
+}
+
+MatchScore Scoring::score(const Video *left, const Video *right) const
+{
+    MatchScore result;
+    result.durationModifier = durationModifier(left, right);
+
+    const int leftSlots = left->hashSlots();
+    const int rightSlots = right->hashSlots();
+    for(int leftHash=0; leftHash<leftSlots; leftHash++)
+    {                               //if cutEnds mode: similarity is always the best one of both comparisons
+        for(int rightHash=0; rightHash<rightSlots; rightHash++)
+        {
+            if(leftHash >= left->hashCount() && rightHash >= right->hashCount())
+                continue;                               //variant against variant is same as original against original
+            const uint64_t leftValue = left->hashAt(leftHash);
+            const uint64_t rightValue = right->hashAt(rightHash);
+            if(leftValue == 0 && rightValue == 0)
+                continue;
+            const int distance = Temporal::hammingDistance(leftValue, rightValue);
+            const int phashSimilarity = qMin(64 - distance + result.durationModifier, 64);
+            if(distance < result.distance)
+            {
+                result.distance = distance;
+                if(_prefs._comparisonMode == _prefs._PHASH)
+                    result.similarity = phashSimilarity;
+            }
+
+            if(_prefs._comparisonMode == _prefs._PHASH)
+            {
+                if(phashSimilarity >= _prefs._thresholdPhash && phashSimilarity <= _prefs._thresholdPhashMax &&
+                   fineHashAgrees(left->fineHashAt(leftHash), right->fineHashAt(rightHash), result.durationModifier))
+                {
+                    result.distance = distance;
+                    result.similarity = phashSimilarity;
+                    result.match = true;
+                    return result;
+                }
+            }                           //ssim comparison is slow, only do it if pHash differs at most 20 bits of 64
+            else if(phashSimilarity >= qMax(_prefs._thresholdPhash, 44))
+            {
+                const double ssimResult = ssim(left->grayThumbAt(leftHash), right->grayThumbAt(rightHash), _prefs._ssimBlockSize);
+                const double similarity = ssimResult + result.durationModifier / 64.0;  // b/64 bits (phash) <=> p/100 % (ssim)
+                if(similarity > result.similarity)
+                {
+                    result.distance = distance;
+                    result.ssim = ssimResult;
+                    result.similarity = similarity;
+                }
+                if(similarity > _prefs._thresholdSSIM && similarity <= _prefs._thresholdSSIMMax)
+                {
+                    result.distance = distance;
+                    result.ssim = ssimResult;
+                    result.similarity = similarity;
+                    result.match = true;
+                    return result;
+                }
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,47 @@
+#ifndef SCORING_H
+#define SCORING_H
+
+#include "prefs.h"
+
+class Video;
+
+struct MatchScore
+{
+    int distance = 64;              //differing bits of best hash pair
+    int durationModifier = 0;       //added to pHash similarity, from comparing durations
+    double ssim = 0.0;              //of best hash pair, if it was calculated (ssim mode)
+    double similarity = 0.0;        //same bits (pHash mode) or ssim index, as shown to user
+    bool match = false;
+};
+
+//scores a pair of videos without touching any shared state, so it can be called from any thread
+class Scoring
+{
+public:
+    explicit Scoring(const Prefs &prefs) : _prefs(prefs) { }
+
+    //compares captures only: if cutEnds mode, every tile of left against every tile of right,
+    //and hash variants of each video against original hashes of the other. With fine hashes,
+    //64 bit ones only find candidates and 256 bit ones decide
+    MatchScore score(const Video *left, const Video *right) const;
+
+    //same bits of two hashes (0 if both are black), including duration modifier
+    int phashSimilarity(const Video *left, const Video *right, const int &leftHash, const int &rightHash) const;
+
+    int durationModifier(const Video *left, const Video *right) const;
+
+    //largest pHash distance a matching pair can have with most favourable duration modifier,
+    //so hash indexes can skip pairs further apart
+    int maxHashDistance() const;
+
+    //second stage of pHash mode: pair found by 64 bit hashes must be as similar by 256 bit hashes
+    //(always true if fine hashes are not enabled)
+    bool fineHashAgrees(const uint64_t *left, const uint64_t *right, const int &durationModifier) const;
+
+    static double ssim(const uint8_t *m0, const uint8_t *m1, const int &block_size);
+
+private:
+    const Prefs &_prefs;            //owner's preferences, thresholds can change between calls
+};
+
+#endif // SCORING_H
@@ -0,0 +1,354 @@
+#include <QSaveFile>
+#include <QSet>
+#include <cstring>
+#include <algorithm>
+#include "snapshot.h"
+#include "video.h"
+
+namespace
+{
+    const char magic[8] = { 'V', 'D', 'P', 'S', 'N', 'A', 'P', '\0' };
+
+    struct StringRef
+    {
+        uint32_t offset;
+        uint32_t length;                //bytes of utf-8
+    };
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t thumbnails;            //thumbnail mode, decides how many hashes each video has
+        uint32_t hashVariants;
+        uint32_t count;                 //videos
+        uint32_t fineHashes;            //fine hash block is only there if set
+        uint32_t padding;
+        uint64_t slots;                 //hashes of all videos, variants included
+        uint64_t idsOffset;
+        uint64_t recordsOffset;
+        uint64_t hashesOffset;
+        uint64_t ssimOffset;
+        uint64_t fineOffset;
+        uint64_t stringsOffset;
+        uint64_t fileSize;
+        int32_t comparisonMode;         //settings of search that wrote snapshot, for comparing it elsewhere
+        int32_t ssimBlockSize;
+        int32_t thresholdPhash;
+        int32_t thresholdPhashMax;
+        double thresholdSSIM;
+        double thresholdSSIMMax;
+        int32_t differentDurationModifier;
+        int32_t sameDurationModifier;
+    };
+
+    struct IdEntry
+    {
+        uint8_t id[16];                 //content id (md5) as raw bytes
+        uint32_t record;
+        uint32_t padding;
+    };
+
+    struct Record
+    {
+        int64_t size;
+        int64_t duration;
+        double framerate;
+        int32_t bitrate;
+        int16_t width;
+        int16_t height;
+        uint32_t firstSlot;             //index of first hash in hash array and ssim blocks
+        uint16_t hashCount;             //original hashes, followed by variants
+        uint16_t slotCount;
+        StringRef path;
+        StringRef codec;
+        StringRef audio;
+    };
+
+    constexpr int _ssimBlock = Video::_ssimBytes;
+    constexpr int _fineBlock = Video::_fineHashWords * sizeof(uint64_t);
+
+    uint64_t aligned(const uint64_t &offset) { return (offset + 7) & ~static_cast<uint64_t>(7); }
+
+    const Header *headerOf(const uchar *data) { return reinterpret_cast<const Header *>(data); }
+}
+
+Snapshot::Snapshot(const QString &filename) : _file(filename)
+{
+    if(!_file.open(QIODevice::ReadOnly) || _file.size() < static_cast<qint64>(sizeof(Header)))
+        return;
+    _data = _file.map(0, _file.size());
+    if(!_data)
+        return;
+    _size = _file.size();
+
+    const Header *header = headerOf(_data);                 //anything inconsistent: treat as if there was no file
+    const uint64_t end = header->stringsOffset;
+    if(memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version ||
+       header->fileSize != static_cast<uint64_t>(_size) ||
+       header->idsOffset + header->count * sizeof(IdEntry) > header->recordsOffset ||
+       header->recordsOffset + header->count * sizeof(Record) > header->hashesOffset ||
+       header->hashesOffset + header->slots * sizeof(uint64_t) > header->ssimOffset ||
+       header->ssimOffset + header->slots * _ssimBlock > header->fineOffset ||
+       header->fineOffset + (header->fineHashes? header->slots * _fineBlock : 0) > end || end > header->fileSize)
+    {
+        _file.unmap(const_cast<uchar *>(_data));
+        _data = nullptr;
+        _size = 0;
+    }
+}
+
+Snapshot::~Snapshot()
+{
+    if(_data)
+        _file.unmap(const_cast<uchar *>(_data));    //file can be replaced after this
+}
+
+bool Snapshot::usable(const Prefs &prefs) const
+{
+    if(!_data)
+        return false;
+    const Header *header = headerOf(_data);
+    return header->thumbnails == static_cast<uint32_t>(prefs._thumbnails) &&
+           header->hashVariants == static_cast<uint32_t>(prefs._hashVariants) &&
+           header->fineHashes == static_cast<uint32_t>(prefs._fineHash);
+}
+
+int Snapshot::count() const
+{
+    return _data? static_cast<int>(headerOf(_data)->count) : 0;
+}
+
+int Snapshot::find(const QByteArray &id) const
+{
+    if(!_data || id.size() != 16)
+        return -1;
+    const Header *header = headerOf(_data);
+    const IdEntry *first = reinterpret_cast<const IdEntry *>(_data + header->idsOffset);
+    const IdEntry *last = first + header->count;
+    const IdEntry *found = std::lower_bound(first, last, id, [](const IdEntry &entry, const QByteArray &wanted)
+        { return memcmp(entry.id, wanted.constData(), 16) < 0; });
+    if(found == last || memcmp(found->id, id.constData(), 16) != 0)
+        return -1;
+    return static_cast<int>(found->record);
+}
+
+QString Snapshot::string(const uint32_t &offset, const uint32_t &length) const
+{
+    const Header *header = headerOf(_data);
+    if(header->stringsOffset + offset + length > header->fileSize)
+        return QString();
+    return QString::fromUtf8(reinterpret_cast<const char *>(_data + header->stringsOffset + offset), static_cast<int>(length));
+}
+
+bool Snapshot::fill(Video &video) const
+{
+    const int index = find(QByteArray::fromHex(video.id.toLatin1()));
+    return index >= 0 && fillRecord(video, index);
+}
+
+QVector<Video *> Snapshot::load(VideoArena &arena) const
+{
+    QVector<Video *> videos;
+    if(!_data)
+        return videos;
+    const Header *header = headerOf(_data);
+    const IdEntry *ids = reinterpret_cast<const IdEntry *>(_data + header->idsOffset);
+    const Record *records = reinterpret_cast<const Record *>(_data + header->recordsOffset);
+
+    videos.fill(nullptr, count());
+    for(int entry=0; entry<count(); entry++)
+    {
+        const int index = static_cast<int>(ids[entry].record);
+        if(index >= count())
+            continue;
+        const QString id = QByteArray(reinterpret_cast<const char *>(ids[entry].id), 16).toHex();
+        Video *video = arena.create(string(records[index].path.offset, records[index].path.length), QDateTime(), id);
+        if(fillRecord(*video, index))
+            videos[index] = video;
+    }
+    videos.removeAll(nullptr);          //only if file is damaged, all processes loading it still agree on indexes
+    return videos;
+}
+
+int Snapshot::thumbnails() const
+{
+    return _data? static_cast<int>(headerOf(_data)->thumbnails) : -1;
+}
+
+bool Snapshot::hashVariants() const
+{
+    return _data && headerOf(_data)->hashVariants;
+}
+
+bool Snapshot::fineHashes() const
+{
+    return _data && headerOf(_data)->fineHashes;
+}
+
+void Snapshot::comparisonSettings(Prefs &prefs) const
+{
+    if(!_data)
+        return;
+    const Header *header = headerOf(_data);
+    prefs._comparisonMode = header->comparisonMode;
+    prefs._ssimBlockSize = header->ssimBlockSize;
+    prefs._thresholdPhash = header->thresholdPhash;
+    prefs._thresholdPhashMax = header->thresholdPhashMax;
+    prefs._thresholdSSIM = header->thresholdSSIM;
+    prefs._thresholdSSIMMax = header->thresholdSSIMMax;
+    prefs._differentDurationModifier = header->differentDurationModifier;
+    prefs._sameDurationModifier = header->sameDurationModifier;
+}
+
+bool Snapshot::fillRecord(Video &video, const int &index) const
+{
+    const Header *header = headerOf(_data);
+    const Record &record = reinterpret_cast<const Record *>(_data + header->recordsOffset)[index];
+    if(record.firstSlot + static_cast<uint64_t>(record.slotCount) > header->slots || record.hashCount != video.hashCount() ||
+       record.slotCount < record.hashCount)
+        return false;
+
+    const uint64_t *hashes = reinterpret_cast<const uint64_t *>(_data + header->hashesOffset) + record.firstSlot;
+    const uint8_t *ssim = _data + header->ssimOffset + static_cast<uint64_t>(record.firstSlot) * _ssimBlock;
+    const uint8_t *fine = _data + header->fineOffset + static_cast<uint64_t>(record.firstSlot) * _fineBlock;
+    video.mapHashes(hashes, ssim, header->fineHashes? reinterpret_cast<const uint64_t *>(fine) : nullptr, record.slotCount);
+
+    video.size = record.size;                       //path and modification date stay those of file found now
+    video.duration = record.duration;
+    video.framerate = record.framerate;
+    video.bitrate = record.bitrate;
+    video.width = record.width;
+    video.height = record.height;
+    video.codec = string(record.codec.offset, record.codec.length);
+    video.audio = string(record.audio.offset, record.audio.length);
+    video.cachedMetadata = true;
+    return true;
+}
+
+bool Snapshot::write(const QString &filename, const QVector<Video *> &videos, const Prefs &prefs)
+{
+    QVector<const Video *> kept;
+    QSet<QString> seen;
+    for(const Video *video : videos)                //identical copies share a content id, one entry is enough
+        if(QByteArray::fromHex(video->id.toLatin1()).size() == 16 && !seen.contains(video->id))
+        {
+            seen << video->id;
+            kept << video;
+        }
+
+    QVector<IdEntry> ids(kept.count());
+    QVector<Record> records(kept.count());
+    uint64_t slots = 0;                             //hash sections are streamed into file below, they may exceed 2 GB
+    QByteArray strings;
+    auto addString = [&strings](const QString &text)
+    {
+        const QByteArray utf8 = text.toUtf8();
+        const StringRef ref{ static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(utf8.size()) };
+        strings += utf8;
+        return ref;
+    };
+
+    for(int i=0; i<kept.count(); i++)
+    {
+        const Video *video = kept[i];
+        const QByteArray id = QByteArray::fromHex(video->id.toLatin1());
+        memcpy(ids[i].id, id.constData(), 16);
+        ids[i].record = static_cast<uint32_t>(i);
+        ids[i].padding = 0;
+
+        Record &record = records[i];
+        record.size = video->size;
+        record.duration = video->duration;
+        record.framerate = video->framerate;
+        record.bitrate = video->bitrate;
+        record.width = video->width;
+        record.height = video->height;
+        record.firstSlot = static_cast<uint32_t>(slots);
+        record.hashCount = static_cast<uint16_t>(video->hashCount());
+        record.slotCount = static_cast<uint16_t>(video->hashSlots());
+        record.path = addString(video->filename);
+        record.codec = addString(video->codec);
+        record.audio = addString(video->audio);
+        slots += static_cast<uint64_t>(video->hashSlots());
+    }
+    std::sort(ids.begin(), ids.end(), [](const IdEntry &a, const IdEntry &b) { return memcmp(a.id, b.id, 16) < 0; });
+
+    Header header;
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.thumbnails = static_cast<uint32_t>(prefs._thumbnails);
+    header.hashVariants = prefs._hashVariants;
+    header.count = static_cast<uint32_t>(kept.count());
+    header.fineHashes = prefs._fineHash;
+    header.padding = 0;
+    header.comparisonMode = prefs._comparisonMode;
+    header.ssimBlockSize = prefs._ssimBlockSize;
+    header.thresholdPhash = prefs._thresholdPhash;
+    header.thresholdPhashMax = prefs._thresholdPhashMax;
+    header.thresholdSSIM = prefs._thresholdSSIM;
+    header.thresholdSSIMMax = prefs._thresholdSSIMMax;
+    header.differentDurationModifier = prefs._differentDurationModifier;
+    header.sameDurationModifier = prefs._sameDurationModifier;
+    header.slots = slots;
+    header.idsOffset = aligned(sizeof(Header));
+    header.recordsOffset = aligned(header.idsOffset + ids.count() * sizeof(IdEntry));
+    header.hashesOffset = aligned(header.recordsOffset + records.count() * sizeof(Record));
+    header.ssimOffset = aligned(header.hashesOffset + slots * sizeof(uint64_t));
+    header.fineOffset = aligned(header.ssimOffset + slots * _ssimBlock);
+    header.stringsOffset = aligned(header.fineOffset + (prefs._fineHash? slots * _fineBlock : 0));
+    header.fileSize = header.stringsOffset + static_cast<uint64_t>(strings.size());
+
+    QSaveFile file(filename);                       //old snapshot stays intact if writing fails
+    if(!file.open(QIODevice::WriteOnly))
+        return false;
+    auto padTo = [&file](const uint64_t &offset)
+    {
+        while(static_cast<uint64_t>(file.pos()) < offset)
+            file.putChar('\0');                     //padding up to aligned offset
+    };
+    auto writeAt = [&file, &padTo](const uint64_t &offset, const char *data, const qint64 &bytes)
+    {
+        padTo(offset);
+        return file.write(data, bytes) == bytes;
+    };
+    enum Section { hashSection, ssimSection, fineSection };
+    auto writeSection = [&file, &padTo, &kept](const uint64_t &offset, const Section &section)
+    {
+        padTo(offset);
+        for(const Video *video : kept)              //same order as firstSlot of records
+            for(int slot=0; slot<video->hashSlots(); slot++)
+            {
+                const uint64_t hash = video->hashAt(slot);
+                const char *data = reinterpret_cast<const char *>(&hash);
+                qint64 bytes = sizeof(uint64_t);
+                if(section == ssimSection)
+                {
+                    data = reinterpret_cast<const char *>(video->grayThumbAt(slot));
+                    bytes = _ssimBlock;
+                }
+                else if(section == fineSection)
+                {
+                    data = reinterpret_cast<const char *>(video->fineHashAt(slot));
+                    bytes = _fineBlock;
+                }
+                if(file.write(data, bytes) != bytes)
+                    return false;
+            }
+        return true;
+    };
+    const bool written =
+        writeAt(0, reinterpret_cast<const char *>(&header), sizeof(Header)) &&
+        writeAt(header.idsOffset, reinterpret_cast<const char *>(ids.constData()), ids.count() * static_cast<qint64>(sizeof(IdEntry))) &&
+        writeAt(header.recordsOffset, reinterpret_cast<const char *>(records.constData()), records.count() * static_cast<qint64>(sizeof(Record))) &&
+        writeSection(header.hashesOffset, hashSection) &&
+        writeSection(header.ssimOffset, ssimSection) &&
+        (!prefs._fineHash || writeSection(header.fineOffset, fineSection)) &&
+        writeAt(header.stringsOffset, strings.constData(), strings.size());
+    if(!written)
+    {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
@@ -0,0 +1,55 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QFile>
+#include "prefs.h"
+
+class Video;
+class VideoArena;
+
+//flat file of capture fingerprints and metadata of every video of last search, memory mapped when opened.
+//Videos found in it read their hashes in place from the mapping instead of reading cache rows and decoding JPEGs,
+//so it must stay open while they are used. Only metadata and strings are copied.
+//Layout: header, id table sorted by content id, records, hash array, ssim blocks, fine hashes, string pool (paths, codecs)
+class Snapshot
+{
+public:
+    explicit Snapshot(const QString &filename);
+    ~Snapshot();
+
+    //false if file is missing, truncated, of other version or taken with other thumbnail mode, hash variants or fine hashes
+    bool usable(const Prefs &prefs) const;
+
+    //copies metadata of video with same content id and points its hashes into snapshot, false if it is not in snapshot
+    bool fill(Video &video) const;
+
+    int count() const;
+
+    //every video of snapshot in order it was written, so other processes loading same file agree on indexes
+    //Video::setPrefs() must have been called with settings of snapshot
+    QVector<Video *> load(VideoArena &arena) const;
+
+    //settings snapshot was taken with, -1 and false if there is no usable file
+    int thumbnails() const;
+    bool hashVariants() const;
+    bool fineHashes() const;
+
+    //comparison mode, thresholds and duration modifiers of search that wrote snapshot, prefs unchanged if unusable
+    void comparisonSettings(Prefs &prefs) const;
+
+    //replaces file, returns false if it could not be written
+    static bool write(const QString &filename, const QVector<Video *> &videos, const Prefs &prefs);
+
+    static constexpr uint32_t version = 4;
+
+private:
+    QFile _file;
+    const uchar *_data = nullptr;
+    qint64 _size = 0;
+
+    int find(const QByteArray &id) const;       //binary search in id table, -1 if not found
+    bool fillRecord(Video &video, const int &index) const;
+    QString string(const uint32_t &offset, const uint32_t &length) const;
+};
+
+#endif // SNAPSHOT_H
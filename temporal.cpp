@@ -0,0 +1,166 @@
+#include "temporal.h"
+#include "video.h"
+
+int Temporal::hammingDistance(const uint64_t &left, const uint64_t &right)
+{
+    int distance = 0;
+    uint64_t differentBits = left ^ right;
+    while(differentBits)
+    {
+        differentBits &= differentBits - 1;
+        distance++;
+    }
+    return distance;
+}
+
+bool Temporal::sharesEarlierBand(const uint64_t &left, const uint64_t &right, const int &band)
+{
+    for(int earlier=0; earlier<band; earlier++)
+        if(bandKey(left, earlier) == bandKey(right, earlier))
+            return true;
+    return false;
+}
+
+TemporalMatch Temporal::scoreOffset(const QVector<uint64_t> &left, const QVector<uint64_t> &right,
+                                    const int &offset, const int &maxDistance)
+{
+    TemporalMatch result;
+    result.offset = offset;
+    int sameBits = 0;
+
+    const int first = qMax(0, -offset);
+    const int last = qMin(left.count(), right.count() - offset);
+    for(int i=first; i<last; i++)
+    {
+        const uint64_t leftHash = left[i];
+        const uint64_t rightHash = right[i + offset];
+        if(leftHash == 0 || rightHash == 0)             //black frames match everything, ignore them
+            continue;
+        result.overlap++;
+        const int distance = hammingDistance(leftHash, rightHash);
+        if(distance <= maxDistance)
+        {
+            result.matched++;
+            sameBits += 64 - distance;
+        }
+    }
+    if(result.matched)
+        result.similarity = sameBits / (64.0 * result.matched);
+    return result;
+}
+
+static TemporalMatch bestAround(const QVector<uint64_t> &left, const QVector<uint64_t> &right,
+                                const int &offset, const int &maxDistance, const int &minFrames)
+{
+    TemporalMatch best;
+    for(int shift=offset-1; shift<=offset+1; shift++)   //keyframes may shift a capture by one interval
+    {
+        const TemporalMatch match = Temporal::scoreOffset(left, right, shift, maxDistance);
+        if(match.matched > best.matched)
+            best = match;
+    }
+    if(best.matched < minFrames || best.matched * 2 < best.overlap)  //most of overlapping part must be same
+        return TemporalMatch();
+    return best;
+}
+
+TemporalMatch Temporal::align(const QVector<uint64_t> &left, const QVector<uint64_t> &right,
+                              const int &maxDistance, const int &minFrames)
+{
+    if(left.count() < minFrames || right.count() < minFrames)
+        return TemporalMatch();
+
+    QHash<uint32_t, QVector<int>> buckets;              //band key -> positions in right sequence
+    for(int j=0; j<right.count(); j++)
+        if(right[j] != 0)
+            for(int band=0; band<bands; band++)
+                buckets[bandKey(right[j], band)] << j;
+
+    QHash<int, int> votes;                              //offset -> frames agreeing on it
+    for(int i=0; i<left.count(); i++)
+    {
+        if(left[i] == 0)
+            continue;
+        for(int band=0; band<bands; band++)
+            for(const int j : buckets.value(bandKey(left[i], band)))
+                if(!sharesEarlierBand(left[i], right[j], band) && hammingDistance(left[i], right[j]) <= maxDistance)
+                    votes[j - i]++;
+    }
+
+    int bestOffset = 0;
+    int bestVotes = 0;
+    for(auto vote=votes.cbegin(); vote!=votes.cend(); vote++)
+        if(vote.value() > bestVotes)
+        {
+            bestVotes = vote.value();
+            bestOffset = vote.key();
+        }
+    if(bestVotes == 0)
+        return TemporalMatch();
+
+    return bestAround(left, right, bestOffset, maxDistance, minFrames);
+}
+
+TemporalIndex::TemporalIndex(const QVector<Video *> &videos, const int &maxDistance, const int &minFrames) :
+    _videos(videos), _maxDistance(maxDistance), _minFrames(minFrames)
+{
+    for(int video=0; video<_videos.count(); video++)
+    {
+        const QVector<uint64_t> &sequence = _videos[video]->temporal;
+        for(int pos=0; pos<sequence.count(); pos++)
+            if(sequence[pos] != 0)
+                for(int band=0; band<Temporal::bands; band++)
+                    _buckets[Temporal::bandKey(sequence[pos], band)] << qMakePair(video, pos);
+    }
+
+    for(auto bucket=_buckets.begin(); bucket!=_buckets.end(); )
+        if(bucket.value().count() > _maxBucketSize)
+            bucket = _buckets.erase(bucket);
+        else
+            bucket++;
+}
+
+QHash<int, TemporalMatch> TemporalIndex::matches(const int &index) const
+{
+    QHash<int, TemporalMatch> result;
+    const QVector<uint64_t> &sequence = _videos[index]->temporal;
+    if(sequence.count() < _minFrames)
+        return result;
+
+    QHash<QPair<int, int>, int> votes;                  //(other video, offset) -> frames agreeing on it
+    for(int pos=0; pos<sequence.count(); pos++)
+    {
+        const uint64_t hash = sequence[pos];
+        if(hash == 0)
+            continue;
+        for(int band=0; band<Temporal::bands; band++)
+        {
+            const auto bucket = _buckets.constFind(Temporal::bandKey(hash, band));
+            if(bucket == _buckets.cend())
+                continue;
+            for(const auto &frame : bucket.value())
+            {
+                if(frame.first <= index)                //every pair is reported only once
+                    continue;
+                const uint64_t other = _videos[frame.first]->temporal[frame.second];
+                if(Temporal::sharesEarlierBand(hash, other, band) || Temporal::hammingDistance(hash, other) > _maxDistance)
+                    continue;
+                votes[qMakePair(frame.first, frame.second - pos)]++;
+            }
+        }
+    }
+
+    QHash<int, QPair<int, int>> bestOffsets;            //other video -> (offset, votes)
+    for(auto vote=votes.cbegin(); vote!=votes.cend(); vote++)
+        if(vote.value() > bestOffsets.value(vote.key().first, qMakePair(0, 0)).second)
+            bestOffsets[vote.key().first] = qMakePair(vote.key().second, vote.value());
+
+    for(auto best=bestOffsets.cbegin(); best!=bestOffsets.cend(); best++)
+    {
+        const TemporalMatch match = bestAround(sequence, _videos[best.key()]->temporal,
+                                               best.value().first, _maxDistance, _minFrames);
+        if(match.matched)
+            result[best.key()] = match;
+    }
+    return result;
+}
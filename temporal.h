@@ -0,0 +1,56 @@
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include <QHash>
+#include <QVector>
+
+class Video;
+
+struct TemporalMatch
+{
+    int offset = 0;             //right sequence position = left sequence position + offset
+    int matched = 0;            //frames within distance at best offset
+    int overlap = 0;            //frames where both sequences have a usable (non black) hash
+    double similarity = 0.0;    //average identical bits of matched frames / 64
+};
+
+class Temporal
+{
+public:
+    //find best offset between two sequences of frame pHashes, zero similarity if not aligned well enough
+    static TemporalMatch align(const QVector<uint64_t> &left, const QVector<uint64_t> &right,
+                               const int &maxDistance, const int &minFrames);
+
+    //count frames within maxDistance when right sequence is shifted by offset
+    static TemporalMatch scoreOffset(const QVector<uint64_t> &left, const QVector<uint64_t> &right,
+                                     const int &offset, const int &maxDistance);
+
+    static int hammingDistance(const uint64_t &left, const uint64_t &right);
+
+    //64 bit pHash is split into 16 bit bands, frames within a few bits of each other share at least one band
+    static constexpr int bands = 4;
+    static uint32_t bandKey(const uint64_t &hash, const int &band)
+        { return static_cast<uint32_t>(band) << 16 | static_cast<uint32_t>(hash >> (band * 16) & 0xFFFF); }
+
+    //true if frame pair was already found through an earlier band (so each pair is counted only once)
+    static bool sharesEarlierBand(const uint64_t &left, const uint64_t &right, const int &band);
+};
+
+class TemporalIndex
+{
+public:
+    TemporalIndex(const QVector<Video *> &videos, const int &maxDistance, const int &minFrames);
+
+    //all videos with larger index than video[index] whose sequence aligns with it, key is index of other video
+    QHash<int, TemporalMatch> matches(const int &index) const;
+
+private:
+    const QVector<Video *> &_videos;
+    int _maxDistance;
+    int _minFrames;
+    QHash<uint32_t, QVector<QPair<int, int>>> _buckets;     //band key -> (video index, frame position)
+
+    static constexpr int _maxBucketSize = 512;              //very common bands (static scenes) carry no information
+};
+
+#endif // TEMPORAL_H
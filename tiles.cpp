@@ -0,0 +1,43 @@
+#include <cmath>
+#include "tiles.h"
+
+TileScheduler::TileScheduler(const int &count, const int &tileSize) :
+    _count(count), _tileSize(tileSize), _tileRows((count + tileSize - 1) / tileSize),
+    _tileCount(_tileRows * (_tileRows + 1) / 2), _next(0)       //blocks below diagonal hold no pairs
+{
+}
+
+bool TileScheduler::next(Tile &tile)
+{
+    const int64_t taken = _next++;
+    if(taken >= _tileCount)
+        return false;
+    tile = tileAt(taken);
+    return true;
+}
+
+Tile TileScheduler::tileAt(const int64_t &number) const
+{
+    //row r holds _tileRows - r blocks, so it starts at r * (2 * _tileRows - r + 1) / 2: solve that for r,
+    //then step over rounding error of floating point
+    const double b = 2.0 * _tileRows + 1;
+    int64_t row = static_cast<int64_t>((b - std::sqrt(qMax(0.0, b * b - 8.0 * number))) / 2);
+    row = qBound(static_cast<int64_t>(0), row, _tileRows - 1);
+    while(row > 0 && firstOfRow(row) > number)
+        row--;
+    while(row + 1 < _tileRows && firstOfRow(row + 1) <= number)
+        row++;
+    const int64_t column = row + number - firstOfRow(row);
+
+    Tile tile;
+    tile.rowStart = static_cast<int>(row * _tileSize);
+    tile.rowEnd = qMin(tile.rowStart + _tileSize, _count);
+    tile.columnStart = static_cast<int>(column * _tileSize);
+    tile.columnEnd = qMin(tile.columnStart + _tileSize, _count);
+    const int64_t rows = tile.rowEnd - tile.rowStart;
+    if(row == column)                           //on diagonal only pairs with right > left
+        tile.pairs = rows * (rows - 1) / 2;
+    else
+        tile.pairs = rows * (tile.columnEnd - tile.columnStart);
+    return tile;
+}
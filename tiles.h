@@ -0,0 +1,40 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <QVector>
+#include <atomic>
+
+struct Tile
+{
+    int rowStart = 0;           //left videos [rowStart, rowEnd)
+    int rowEnd = 0;
+    int columnStart = 0;        //right videos [columnStart, columnEnd), only pairs with right > left are compared
+    int columnEnd = 0;
+    int64_t pairs = 0;
+};
+
+//splits upper triangle of all video pairs into square blocks, small enough that both rows and columns
+//of a block stay in cache while it is compared. Threads take next free block, so none is left idle.
+//Blocks are numbered row by row and computed from their number when taken, nothing is stored per block
+class TileScheduler
+{
+public:
+    static constexpr int _defaultTileSize = 32;         //2 x 32 videos fit in L2 cache
+
+    TileScheduler(const int &count, const int &tileSize=_defaultTileSize);
+
+    //thread safe, false when all tiles are taken
+    bool next(Tile &tile);
+
+private:
+    const int _count;
+    const int _tileSize;
+    const int64_t _tileRows;
+    const int64_t _tileCount;
+    std::atomic<int64_t> _next;
+
+    int64_t firstOfRow(const int64_t &row) const { return row * _tileRows - row * (row - 1) / 2; }
+    Tile tileAt(const int64_t &number) const;
+};
+
+#endif // TILES_H
@@ -1,53 +1,88 @@
 #include <QPainter>
 #include "video.h"
+#include "metrics.h"
+#include "capturecodec.h"
 #include <memory>
+#include <algorithm>
 
 Prefs Video::_prefs;
-int Video::_jpegQuality = _okJpegQuality;
+const uint64_t Video::_noFineHash[_fineHashWords] = {};
 
-Video::Video(const Prefs &prefsParam, const QString &filenameParam, const QDateTime &dateModParam) : filename(filenameParam)
+Video::Video(const QString &filenameParam, const QDateTime &dateModParam, const QString &idParam) :
+    filename(filenameParam), id(idParam)
 {
-    _prefs = prefsParam;
     modified = dateModParam;
-    filename = filenameParam;
-    id = Db::uniqueId(filenameParam, modified, "");
-    if(_prefs._numberOfVideos > _hugeAmountVideos)       //save memory to avoid crash due to 32 bit limit
-        _jpegQuality = _lowJpegQuality;
+}
+
+VideoTask::VideoTask(Video *video, QObject *receiver) : _video(video)
+{
+    QObject::connect(this, SIGNAL(rejectVideo(Video *)), receiver, SLOT(removeVideo(Video *)));
+    QObject::connect(this, SIGNAL(acceptVideo(Video *)), receiver, SLOT(addVideo(Video *)));
+}
+
+void VideoTask::run()
+{
+    if(_video->process())
+    {
+        Metrics::instance().count("videos accepted");
+        emit acceptVideo(_video);
+    }
+    else
+    {
+        Metrics::instance().count("videos rejected");
+        emit rejectVideo(_video);
+    }
+}
 
-    QObject::connect(this, SIGNAL(rejectVideo(Video *)), _prefs._mainwPtr, SLOT(removeVideo(Video *)));
-    QObject::connect(this, SIGNAL(acceptVideo(Video *)), _prefs._mainwPtr, SLOT(addVideo(Video *)));
+Video *VideoArena::create(const QString &filename, const QDateTime &dateMod, const QString &id)
+{
+    if(_count == static_cast<int>(_chunks.size()) * _chunkSize)
+        _chunks.emplace_back(new Slot[_chunkSize]);
+    Slot *slot = &_chunks.back()[_count % _chunkSize];
+    _count++;
+    return new (slot) Video(filename, dateMod, id);
 }
 
-void Video::run()
+void VideoArena::clear()
+{
+    for(int i=0; i<_count; i++)             //only strings and vectors inside need freeing, no QObject bookkeeping
+        reinterpret_cast<Video *>(&_chunks[static_cast<size_t>(i / _chunkSize)][i % _chunkSize])->~Video();
+    _chunks.clear();
+    _count = 0;
+}
+
+bool Video::process()
 {
     std::unique_ptr<Db> cache;
     if(!cachedMetadata)      //check first if video properties are cached
     {
-        cache = std::make_unique<Db>(id, _prefs._mainwPtr);
+        cache = std::make_unique<Db>(filename, _prefs._mainwPtr);
         getMetadata(filename);          //if not, read them with ffmpeg
         cache->writeMetadata(*this);
         cachedMetadata = false;
     }
 
     if(width == 0 || height == 0 || duration == 0 || size < _prefs._minSizeBytes || duration < _prefs._minTimeMs)
-    {
-        emit rejectVideo(this);
-        return;
-    }
+        return false;
 
     const int ret = takeScreenCaptures(cache);
+    if(ret == _success && _prefs._temporal && temporal.isEmpty())
+        takeTemporalFingerprint(cache);     //failing only means video can't be matched by its frame sequence
+    if(ret == _success && _prefs._audio && !cachedAudio && !audio.isEmpty())
+        takeAudioFingerprint(cache);
+    captures = QHash<int, QByteArray>();        //cached JPEGs are not needed after features are computed
 
     if(ret == _failure)
-        emit rejectVideo(this);
-    else if((_prefs._thumbnails != cutEnds && hash[0] == 0 ) ||
-            (_prefs._thumbnails == cutEnds && hash[0] == 0 && hash[4] == 0))   //all screen captures black
-        emit rejectVideo(this);
-    else
-        emit acceptVideo(this);
+        return false;
+    if((_prefs._thumbnails != cutEnds && hashAt(0) == 0 ) ||
+       (_prefs._thumbnails == cutEnds && hashAt(0) == 0 && hashAt(4) == 0))    //all screen captures black
+        return false;
+    return true;
 }
 
 void Video::getMetadata(const QString &filename)
 {
+    const ScopedTimer timer("probe");
     QProcess probe;
     probe.setProcessChannelMode(QProcess::MergedChannels);
     probe.start(QStringLiteral("ffmpeg -hide_banner -i \"%1\"").arg(QDir::toNativeSeparators(filename)));
@@ -140,17 +175,19 @@ int Video::takeScreenCaptures(std::unique_ptr<Db>& cache)
 //        QByteArray cachedImage = cache.readCapture(percentages[capture]);
         int percent = percentages[capture];
         QByteArray cachedImage = captures[percent];
-        QBuffer captureBuffer(&cachedImage);
         bool writeToCache = false;
 
         if(!cachedImage.isNull())   //image was already in cache
         {
-            frame.load(&captureBuffer, QByteArrayLiteral("JPG"));   //was saved in cache as small size, resize to original
+            const ScopedTimer timer("decode");
+            Metrics::instance().count("captures from cache");
+            frame = CaptureCodec::decode(cachedImage);              //was saved in cache as small size, resize to original
             frame = frame.scaled(width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
         }
         else
         {
             cachedCaptures = false;
+            Metrics::instance().count("captures taken");
             frame = captureAt(percent, ofDuration);
             if(frame.isNull())                                  //taking screen capture may fail if video is broken
             {
@@ -172,12 +209,11 @@ int Video::takeScreenCaptures(std::unique_ptr<Db>& cache)
 
         if(writeToCache)
         {
-            frame = minimizeImage(frame);
-            frame.save(&captureBuffer, QByteArrayLiteral("JPG"), _okJpegQuality);
+            cachedImage = CaptureCodec::encode(minimizeImage(frame), _prefs._captureFormat);
             try {
                     if(!cache){
                         if(!thumbCache){
-                            thumbCache = std::make_unique<Db>(id, _prefs._mainwPtr);
+                            thumbCache = std::make_unique<Db>(filename, _prefs._mainwPtr);
                         }
                         thumbCache->writeCapture(id, percent, cachedImage);
                     } else {
@@ -191,7 +227,7 @@ int Video::takeScreenCaptures(std::unique_ptr<Db>& cache)
 
     const int hashes = _prefs._thumbnails == cutEnds? 16 : 1;    //if cutEnds mode: separate hash for beginning and end
     try {
-        processThumbnail(thumbnail, hashes);
+        processThumbnail(thumbnail, hashes, cache);
     } catch (std::exception &e) {
         return _failure;
     }
@@ -199,37 +235,258 @@ int Video::takeScreenCaptures(std::unique_ptr<Db>& cache)
     return _success;
 }
 
-void Video::processThumbnail(QImage &thumbnail, const int &hashes)
+void Video::processThumbnail(QImage &thumbnail, const int &hashes, std::unique_ptr<Db> &cache)
 {
+    Thumbnail thumb(_prefs._thumbnails);
+    const int cols = hashes == 1? thumb.cols() : 1;     //captures in each hashed image
+    const int rows = hashes == 1? thumb.rows() : 1;
+    const QImage cropped = cropBorders(thumbnail, cache);      //GUI thumbnail keeps borders, only hashes are cropped
+
+    QVector<uint64_t> slotHashes(hashes, 0);
+    QByteArray grayThumbs(hashes * _ssimBytes, '\0');
+    QVector<uint64_t> fineHashes(_prefs._fineHash? hashes * _fineHashWords : 0, 0);
+    QVector<uint64_t> variantHashes;                   //appended after all original hashes
+    QByteArray variantGrayThumbs;
+    QVector<uint64_t> variantFineHashes;
+
     for(int hash=0; hash<hashes; hash++)
     {
-        QImage image = thumbnail;
-        int y = hash / 4;
-        int x = hash % 4;
+        QImage image = cropped;
+        const int tileWidth = cropped.width() / 4;
+        const int tileHeight = cropped.height() / 4;
         if(_prefs._thumbnails == cutEnds)           //if cutEnds mode: separate thumbnail into first and last frames
-            image = thumbnail.copy(x, y, thumbnail.width()/4, thumbnail.height()/4);
+            image = cropped.copy(hash % 4 * tileWidth, hash / 4 * tileHeight, tileWidth, tileHeight);
 
-        cv::Mat mat = cv::Mat(image.height(), image.width(), CV_8UC3, image.bits(), static_cast<uint>(image.bytesPerLine()));
-        this->hash[hash] = computePhash(mat);                           //pHash
+        hashImage(image, slotHashes[hash], reinterpret_cast<uint8_t *>(grayThumbs.data()) + hash * _ssimBytes,
+                  fineHashes.isEmpty()? nullptr : fineHashes.data() + hash * _fineHashWords);
 
-        cv::resize(mat, mat, cv::Size(_ssimSize, _ssimSize), 0, 0, cv::INTER_AREA);
-        cv::cvtColor(mat, grayThumb[hash], cv::COLOR_BGR2GRAY);
-        grayThumb[hash].cv::Mat::convertTo(grayThumb[hash], CV_32F);    //ssim
+        if(!_prefs._hashVariants || slotHashes[hash] == 0)
+            continue;
+        for(int variant=0; variant<_variantCount; variant++)
+        {
+            QImage transformed = variantOf(image, variant, cols, rows);
+            uint64_t variantHash = 0;
+            uint8_t gray[_ssimBytes];
+            uint64_t fine[_fineHashWords];
+            hashImage(transformed, variantHash, gray, fine);
+            if(variantHash == 0 || variantHash == slotHashes[hash])
+                continue;
+            variantHashes << variantHash;
+            variantGrayThumbs.append(reinterpret_cast<const char *>(gray), _ssimBytes);
+            for(int word=0; word<_fineHashWords && !fineHashes.isEmpty(); word++)
+                variantFineHashes << fine[word];
+        }
     }
+    setHashes(slotHashes + variantHashes, grayThumbs + variantGrayThumbs, fineHashes + variantFineHashes);
 
+    if(_prefs._memoryLean)                      //GUI thumbnail is rebuilt from cache by loadThumbnail() when needed
+        return;
     thumbnail = minimizeImage(thumbnail);
     QBuffer buffer(&this->thumbnail);
     thumbnail.save(&buffer, QByteArrayLiteral("JPG"), _jpegQuality);    //save GUI thumbnail as tiny JPEG
 }
 
-uint64_t Video::computePhash(const cv::Mat &input) const
+QImage Video::cropBorders(const QImage &thumbnail, std::unique_ptr<Db> &cache)
+{
+    Thumbnail thumb(_prefs._thumbnails);
+    const QVector<int> percentages = thumb.percentages();
+    const int tileWidth = thumbnail.width() / thumb.cols();
+    const int tileHeight = thumbnail.height() / thumb.rows();
+    const QRectF wholeFrame(0, 0, 1, 1);
+    bool detected = false;
+
+    QImage result = thumbnail;
+    QPainter painter(&result);
+    for(int capture=0; capture<percentages.count(); capture++)
+    {
+        const QRect place(capture % thumb.cols() * tileWidth, capture / thumb.cols() * tileHeight, tileWidth, tileHeight);
+        const int percent = percentages[capture];
+        if(!crops.contains(percent))                    //borders are found on a small copy, stored relative to frame size
+        {
+            const QImage small = thumbnail.copy(place).scaled(_borderScanSize, _borderScanSize,
+                                                              Qt::IgnoreAspectRatio, Qt::FastTransformation);
+            const QRect content = contentRect(small);
+            crops[percent] = QRectF(static_cast<double>(content.x()) / _borderScanSize,
+                                    static_cast<double>(content.y()) / _borderScanSize,
+                                    static_cast<double>(content.width()) / _borderScanSize,
+                                    static_cast<double>(content.height()) / _borderScanSize);
+            detected = true;
+        }
+
+        const QRectF content = crops.value(percent);
+        if(content == wholeFrame)
+            continue;
+        const QRect source(place.x() + qRound(content.x() * tileWidth), place.y() + qRound(content.y() * tileHeight),
+                           qRound(content.width() * tileWidth), qRound(content.height() * tileHeight));
+        painter.drawImage(place, thumbnail, source);    //content stretched over whole frame
+    }
+    painter.end();
+
+    if(detected)
+    {
+        if(!cache)
+            cache = std::make_unique<Db>(filename, _prefs._mainwPtr);
+        cache->writeCrops(id, crops);
+    }
+    crops = QHash<int, QRectF>();
+    return result;
+}
+
+void Video::hashImage(QImage &image, uint64_t &hash, uint8_t *gray, uint64_t *fine) const
+{
+    const ScopedTimer timer("hash");
+    cv::Mat mat = cv::Mat(image.height(), image.width(), CV_8UC3, image.bits(), static_cast<uint>(image.bytesPerLine()));
+    hash = computePhash(mat);                                       //pHash
+    if(_prefs._fineHash && hash != 0)                               //both are 0 for monochrome images
+        computeFineHash(mat, fine);
+    else if(fine)                                                   //null if fine hashes are not used
+        std::fill(fine, fine + _fineHashWords, 0);
+
+    cv::resize(mat, mat, cv::Size(_ssimSize, _ssimSize), 0, 0, cv::INTER_AREA);
+    cv::Mat grayMat(_ssimSize, _ssimSize, CV_8UC1, gray);           //ssim, written straight into packed array
+    cv::cvtColor(mat, grayMat, cv::COLOR_BGR2GRAY);
+}
+
+QImage Video::variantOf(const QImage &image, const int &variant, const int &cols, const int &rows) const
+{
+    QImage result(image.size(), QImage::Format_RGB888);
+    const int tileWidth = image.width() / cols;
+    const int tileHeight = image.height() / rows;
+
+    QPainter painter(&result);
+    for(int capture=0; capture<cols*rows; capture++)    //every capture of mosaic is transformed in its own place
+    {
+        const QRect place(capture % cols * tileWidth, capture / cols * tileHeight, tileWidth, tileHeight);
+        QImage tile = image.copy(place);
+        if(variant == _flipped)
+            tile = tile.mirrored(true, false);
+        else
+            tile = tile.transformed(QTransform().rotate(variant == _rotated90? 90 : 270));
+        painter.drawImage(place, tile);                 //stretched back to tile size, pHash ignores aspect ratio
+    }
+    painter.end();
+    return result;
+}
+
+static bool uniformLine(const QImage &image, const int &position, const bool &isRow, const int &maxVariance)
+{
+    const int length = isRow? image.width() : image.height();
+    int64_t sum = 0, squares = 0;
+    for(int i=0; i<length; i++)
+    {
+        const int64_t gray = qGray(isRow? image.pixel(i, position) : image.pixel(position, i));
+        sum += gray;
+        squares += gray * gray;
+    }
+    return squares * length - sum * sum <= maxVariance * static_cast<int64_t>(length) * length;
+}
+
+QRect Video::contentRect(const QImage &image) const
 {
-    cv::Mat resizeImg, grayImg, grayFImg, dctImg, topLeftDCT;
+    int top = 0, bottom = image.height() - 1, left = 0, right = image.width() - 1;
+    while(top < bottom && uniformLine(image, top, true, _borderVariance))
+        top++;
+    while(bottom > top && uniformLine(image, bottom, true, _borderVariance))
+        bottom--;
+    while(left < right && uniformLine(image, left, false, _borderVariance))
+        left++;
+    while(right > left && uniformLine(image, right, false, _borderVariance))
+        right--;
+
+    const QRect content(QPoint(left, top), QPoint(right, bottom));
+    if(content.width() < image.width() / 2 || content.height() < image.height() / 2)
+        return image.rect();                            //mostly one color (fade, title card), nothing to crop
+    return content;
+}
+
+void Video::setHashes(const QVector<uint64_t> &hashes, const QByteArray &grayThumbs, const QVector<uint64_t> &fineHashes)
+{
+    _ownHashes = hashes;
+    _ownGrayThumbs = grayThumbs;
+    _ownFineHashes = fineHashes;
+    _hashes = _ownHashes.constData();
+    _grayThumbs = reinterpret_cast<const uint8_t *>(_ownGrayThumbs.constData());
+    _fineHashes = _ownFineHashes.isEmpty()? nullptr : _ownFineHashes.constData();
+    _slots = _ownHashes.count();
+    _mapped = false;
+}
+
+void Video::mapHashes(const uint64_t *hashes, const uint8_t *grayThumbs, const uint64_t *fineHashes, const int &slots)
+{
+    _ownHashes = QVector<uint64_t>();
+    _ownGrayThumbs = QByteArray();
+    _ownFineHashes = QVector<uint64_t>();
+    _hashes = hashes;
+    _grayThumbs = grayThumbs;
+    _fineHashes = fineHashes;
+    _slots = slots;
+    _mapped = true;
+}
+
+void Video::detachHashes()
+{
+    if(!_mapped)
+        return;
+    QVector<uint64_t> hashes(_slots);
+    std::copy(_hashes, _hashes + _slots, hashes.begin());
+    QVector<uint64_t> fineHashes(_fineHashes? _slots * _fineHashWords : 0);
+    std::copy(_fineHashes, _fineHashes + fineHashes.count(), fineHashes.begin());
+    setHashes(hashes, QByteArray(reinterpret_cast<const char *>(_grayThumbs), _slots * _ssimBytes), fineHashes);
+}
+
+void Video::copyFeatures(const Video &original)
+{                                               //hash pointers stay valid: owned arrays are shared, not copied
+    const QString ownFilename = filename;
+    const QDateTime ownModified = modified;
+    *this = original;
+    filename = ownFilename;
+    modified = ownModified;
+}
+
+QImage Video::loadThumbnail(const Db &cache) const
+{
+    Thumbnail thumb(_prefs._thumbnails);
+    const QVector<int> percentages = thumb.percentages();
+    const QHash<int, QByteArray> cachedImages = cache.readCaptures(id, percentages);
+
+    QImage thumbnail;
+    for(int capture=0; capture<percentages.count(); capture++)
+    {
+        const QByteArray cachedImage = cachedImages.value(percentages[capture]);
+        QImage frame;
+        if(!cachedImage.isNull())
+            frame = CaptureCodec::decode(cachedImage);
+        if(frame.isNull())                                      //capture could not be written to cache, take it again
+            frame = minimizeImage(captureAt(percentages[capture]));
+        if(frame.isNull())
+            continue;
+
+        if(thumbnail.isNull())                  //cached captures are already small, so mosaic is built at their size
+        {
+            thumbnail = QImage(thumb.cols() * frame.width(), thumb.rows() * frame.height(), QImage::Format_RGB888);
+            thumbnail.fill(Qt::black);
+        }
+        const int tileWidth = thumbnail.width() / thumb.cols();
+        const int tileHeight = thumbnail.height() / thumb.rows();
+        QPainter painter(&thumbnail);
+        painter.drawImage(QRect(capture % thumb.cols() * tileWidth, capture / thumb.cols() * tileHeight,
+                                tileWidth, tileHeight), frame);
+    }
+    return minimizeImage(thumbnail);
+}
+
+uint64_t Video::computePhash(const cv::Mat &input)
+{
+    cv::Mat resizeImg, grayImg;
     cv::resize(input, resizeImg, cv::Size(_pHashSize, _pHashSize), 0, 0, cv::INTER_AREA);
     cv::cvtColor(resizeImg, grayImg, cv::COLOR_BGR2GRAY);           //resize image to 32x32 grayscale
+    return phashOfGray(grayImg);
+}
 
+uint64_t Video::phashOfGray(const cv::Mat &grayImg)
+{
     int shadesOfGray = 0;
-    uchar* pixel = reinterpret_cast<uchar*>(grayImg.data);          //pointer to pixel values, starts at first one
+    const uchar* pixel = grayImg.data;                              //pointer to pixel values, starts at first one
     const uchar* lastPixel = pixel + _pHashSize * _pHashSize;
     const uchar firstPixel = *pixel;
 
@@ -238,21 +495,78 @@ uint64_t Video::computePhash(const cv::Mat &input) const
     if(shadesOfGray < _almostBlackBitmap)
         return 0;                                       //reject video if capture was (almost) monochrome
 
+    uint64_t hash = 0;
+    dctBits(grayImg, _pHashBlock, &hash);
+    return hash;
+}
+
+void Video::computeFineHash(const cv::Mat &input, uint64_t *fine)
+{
+    cv::Mat resizeImg, grayImg;
+    cv::resize(input, resizeImg, cv::Size(_fineHashSize, _fineHashSize), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(resizeImg, grayImg, cv::COLOR_BGR2GRAY);
+    dctBits(grayImg, _fineHashBlock, fine);
+}
+
+void Video::dctBits(const cv::Mat &grayImg, const int &block, uint64_t *bits)
+{
+    cv::Mat grayFImg, dctImg, topLeftDCT;
     grayImg.convertTo(grayFImg, CV_32F);
     cv::dct(grayFImg, dctImg);                          //compute DCT (discrete cosine transform)
-    dctImg(cv::Rect(0, 0, 8, 8)).copyTo(topLeftDCT);    //use only upper left 8*8 transforms (most significant ones)
+    dctImg(cv::Rect(0, 0, block, block)).copyTo(topLeftDCT);    //use only upper left transforms (most significant ones)
 
+    const int count = block * block;
     const float firstElement = *reinterpret_cast<float*>(topLeftDCT.data);      //compute avg but skip first element
-    const float average = (static_cast<float>(cv::sum(topLeftDCT)[0]) - firstElement) / 63;         //(it's very big)
+    const float average = (static_cast<float>(cv::sum(topLeftDCT)[0]) - firstElement) / (count - 1);  //(it's very big)
 
-    uint64_t hash = 0;
-    float* transform = reinterpret_cast<float*>(topLeftDCT.data);
-    const float* endOfData = transform + 64;
-    for(int i=0; transform<endOfData; i++, transform++)             //construct hash from all 8x8 bits
+    const float* transform = reinterpret_cast<float*>(topLeftDCT.data);
+    for(int word=0; word<count/64; word++)
+        bits[word] = 0;
+    for(int i=0; i<count; i++, transform++)             //construct hash from all block*block bits
         if(*transform > average)
-            hash |= 1ULL << i;                                      //larger than avg = 1, smaller than avg = 0
+            bits[i / 64] |= 1ULL << (i % 64);           //larger than avg = 1, smaller than avg = 0
+}
 
-    return hash;
+int Video::takeTemporalFingerprint(std::unique_ptr<Db>& cache)
+{
+    const ScopedTimer timer("temporal");
+    QProcess ffmpeg;                    //only keyframes are decoded, ffmpeg picks nearest one for every interval
+    const QString ffmpegCommand = QStringLiteral("ffmpeg -hide_banner -loglevel error -skip_frame nokey -i \"%1\" -an "
+                                                 "-vf fps=1/%2,scale=%3:%3:flags=area,format=gray -f rawvideo -")
+                                  .arg(QDir::toNativeSeparators(filename)).arg(_prefs._temporalInterval).arg(_pHashSize);
+    ffmpeg.start(ffmpegCommand);
+    if(!ffmpeg.waitForFinished(_temporalTimeout))
+    {
+        ffmpeg.kill();
+        ffmpeg.waitForFinished();
+        return _failure;
+    }
+
+    const QByteArray frames = ffmpeg.readAllStandardOutput();
+    constexpr int frameSize = _pHashSize * _pHashSize;          //raw 32x32 8 bit gray frames, one after another
+    for(int pos=0; pos+frameSize<=frames.size(); pos+=frameSize)
+    {
+        const cv::Mat grayImg(_pHashSize, _pHashSize, CV_8UC1, const_cast<char *>(frames.constData() + pos));
+        temporal << phashOfGray(grayImg);
+    }
+    if(temporal.isEmpty())
+        return _failure;
+
+    if(!cache)
+        cache = std::make_unique<Db>(filename, _prefs._mainwPtr);
+    cache->writeTemporal(id, _prefs._temporalInterval, temporal);
+    return _success;
+}
+
+void Video::takeAudioFingerprint(std::unique_ptr<Db>& cache)
+{
+    const ScopedTimer timer("audio");
+    audioHashes = AudioFingerprint::extract(filename, duration);
+
+    if(!cache)
+        cache = std::make_unique<Db>(filename, _prefs._mainwPtr);
+    cache->writeAudio(id, audioHashes);         //saved even if silent, so it is not decoded again next time
+    cachedAudio = true;
 }
 
 QImage Video::minimizeImage(const QImage &image) const
@@ -292,6 +606,7 @@ QString Video::msToHHMMSS(const int64_t &time) const
 
 QImage Video::captureAt(const int &percent, const int &ofDuration) const
 {
+    const ScopedTimer timer("capture");
     const QTemporaryDir tempDir;
     if(!tempDir.isValid())
         return QImage();
@@ -13,17 +13,23 @@
 #include <opencv2/highgui.hpp>
 #include "prefs.h"
 #include "db.h"
+#include "audiofingerprint.h"
 #include <stdio.h>
 #include <iostream>
 #include <memory>
+#include <type_traits>
+#include <vector>
 
-class Video : public QObject, public QRunnable
+class Video
 {
-    Q_OBJECT
-
 public:
-    Video(const Prefs &prefsParam, const QString &filenameParam, const QDateTime &dateMod);
-    void run();
+    Video(const QString &filenameParam, const QDateTime &dateMod, const QString &idParam);
+
+    //preferences shared by all videos, set once before any video is filled or processed
+    static void setPrefs(const Prefs &prefs) { _prefs = prefs; }
+
+    //read metadata and captures (from cache or with ffmpeg), returns false if video is unusable
+    bool process();
 
     QString filename;
     QString id;
@@ -37,44 +43,142 @@ public:
     short width = 0;
     short height = 0;
     QByteArray thumbnail;
-    cv::Mat grayThumb [16];
-    uint64_t hash [16] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    QVector<uint64_t> temporal;     //pHash every _prefs._temporalInterval seconds, 0 for (almost) black frames
+    QVector<uint32_t> audioHashes;  //sorted spectral peak pair hashes, empty if no (audible) audio
+    bool cachedAudio = false;
     bool cachedMetadata = false;
     bool cachedCaptures = true;
     QHash<int, QByteArray> captures;
+    QHash<int, QRectF> crops;       //content without black bars of each capture (relative to frame size), from cache
 
-private slots:
+private:
     void getMetadata(const QString &filename);
     int takeScreenCaptures(std::unique_ptr<Db>& cache);
-    void processThumbnail(QImage &thumbnail, const int &hashes);
-    uint64_t computePhash(const cv::Mat &input) const;
+    void processThumbnail(QImage &thumbnail, const int &hashes, std::unique_ptr<Db> &cache);
+    QImage cropBorders(const QImage &thumbnail, std::unique_ptr<Db> &cache);
+    int takeTemporalFingerprint(std::unique_ptr<Db>& cache);
+    void takeAudioFingerprint(std::unique_ptr<Db>& cache);
+    void hashImage(QImage &image, uint64_t &hash, uint8_t *gray, uint64_t *fine) const;
+    QImage variantOf(const QImage &image, const int &variant, const int &cols, const int &rows) const;
+    QRect contentRect(const QImage &image) const;
     QImage minimizeImage(const QImage &image) const;
     QString msToHHMMSS(const int64_t &time) const;
     void getBrightest(QString &filename);
 
-public slots:
+public:
     QImage captureAt(const int &percent, const int &ofDuration=100) const;
 
-signals:
-    void acceptVideo(Video *addMe) const;
-    void rejectVideo(Video *deleteMe) const;
+    //64 bit pHash of a color image, 0 if it is (almost) monochrome
+    static uint64_t computePhash(const cv::Mat &input);
+    static uint64_t phashOfGray(const cv::Mat &grayImg);
+
+    //256 bit pHash of a color image for verifying matches of 64 bit one, all 0 if it is (almost) monochrome
+    static void computeFineHash(const cv::Mat &input, uint64_t *fine);
+
+    //bits of lowest block x block DCT coefficients of a square gray image, set where above their average
+    static void dctBits(const cv::Mat &grayImg, const int &block, uint64_t *bits);
+
+    //hashes of all captures ("slots"): hashCount() hashes (16 if cutEnds mode, else 1), followed by flipped and
+    //rotated variants if _prefs._hashVariants. Each slot has a 64 bit pHash, a 16x16 gray thumbnail for ssim and
+    //a 256 bit fine hash (if _prefs._fineHash). They are packed arrays, either owned or inside a mapped snapshot
+    int hashCount() const { return _prefs._thumbnails == cutEnds? 16 : 1; }
+    int hashSlots() const { return _slots; }
+    uint64_t hashAt(const int &slot) const { return _hashes[slot]; }
+    const uint8_t *grayThumbAt(const int &slot) const { return _grayThumbs + slot * _ssimBytes; }
+    const uint64_t *fineHashAt(const int &slot) const               //all 0 if fine hashes are not used
+        { return _fineHashes? _fineHashes + slot * _fineHashWords : _noFineHash; }
+
+    static constexpr int _ssimBytes     = 256;      //per slot in grayThumbAt()
+    static constexpr int _fineHashWords = 4;        //per slot in fineHashAt()
+
+    //keep these arrays of hashSlots() slots, fineHashes empty if fine hashes are not used
+    void setHashes(const QVector<uint64_t> &hashes, const QByteArray &grayThumbs, const QVector<uint64_t> &fineHashes);
+
+    //read hashes in place from arrays that outlive this video (mapped snapshot), fineHashes null if not used
+    void mapHashes(const uint64_t *hashes, const uint8_t *grayThumbs, const uint64_t *fineHashes, const int &slots);
+
+    //copy mapped hashes into this video, so the file they are mapped from can be closed
+    void detachHashes();
+
+    //rebuild GUI thumbnail from cached captures, used when thumbnail was not kept in memory
+    //cache must be a connection of calling thread. Captures missing from cache are taken with ffmpeg, so never call from GUI thread
+    QImage loadThumbnail(const Db &cache) const;
+
+    //take metadata, hashes and fingerprints of a byte identical file instead of processing this one
+    void copyFeatures(const Video &original);
 
 private:
     static Prefs _prefs;
-    static int _jpegQuality;
+    static const uint64_t _noFineHash[_fineHashWords];
+
+    QVector<uint64_t> _ownHashes;       //storage of setHashes(), empty if mapped
+    QByteArray _ownGrayThumbs;
+    QVector<uint64_t> _ownFineHashes;
+    const uint64_t *_hashes = nullptr;
+    const uint8_t *_grayThumbs = nullptr;
+    const uint64_t *_fineHashes = nullptr;
+    int _slots = 0;
+    bool _mapped = false;
 
     enum _returnValues { _success, _failure };
+    enum _variants { _flipped, _rotated90, _rotated270, _variantCount };
 
-    static constexpr int _okJpegQuality      = 60;
-    static constexpr int _lowJpegQuality     = 25;
-    static constexpr int _hugeAmountVideos   = 200000;
+    static constexpr int _jpegQuality        = 60;
     static constexpr int _goBackwardsPercent = 6;       //if capture fails, retry but omit this much from end
     static constexpr int _videoStillUsable   = 90;      //90% of video duration is considered usable
     static constexpr int _thumbnailMaxWidth  = 448;     //small size to save memory and cache space
     static constexpr int _thumbnailMaxHeight = 336;
     static constexpr int _pHashSize          = 32;      //phash generated from 32x32 image
+    static constexpr int _pHashBlock         = 8;       //of which lowest 8x8 DCT coefficients make 64 bit hash
+    static constexpr int _fineHashSize       = 64;      //fine hash: lowest 16x16 of 64x64 image, 256 bits
+    static constexpr int _fineHashBlock      = 16;
     static constexpr int _ssimSize           = 16;      //larger than 16x16 seems to have slower comparison
     static constexpr int _almostBlackBitmap  = 1500;    //monochrome thumbnail if less shades of gray than this
+    static_assert(_ssimBytes == _ssimSize * _ssimSize, "one ssim thumbnail per slot");
+    static_assert(_fineHashWords * 64 == _fineHashBlock * _fineHashBlock, "one fine hash per slot");
+    static constexpr int _borderVariance     = 16;      //row or column of pixels this uniform is a black bar or border
+    static constexpr int _borderScanSize     = 64;      //captures are scaled to 64x64 before looking for borders
+    static constexpr int _temporalTimeout    = 600000;  //decoding keyframes of a long video can take minutes
+};
+
+Q_DECLARE_METATYPE(Video *)
+
+//runs in thread pool for videos that need processing, Video itself is a plain record owned by VideoArena
+class VideoTask : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+public:
+    VideoTask(Video *video, QObject *receiver);
+    void run();
+
+signals:
+    void acceptVideo(Video *addMe) const;
+    void rejectVideo(Video *deleteMe) const;
+
+private:
+    Video *_video;
+};
+
+//videos are constructed in large contiguous chunks instead of one heap allocation each, freed all at once
+class VideoArena
+{
+public:
+    VideoArena() = default;
+    VideoArena(const VideoArena &) = delete;
+    VideoArena &operator=(const VideoArena &) = delete;
+    ~VideoArena() { clear(); }
+
+    Video *create(const QString &filename, const QDateTime &dateMod, const QString &id);
+    void clear();
+    int count() const { return _count; }
+
+private:
+    typedef std::aligned_storage<sizeof(Video), alignof(Video)>::type Slot;
+    std::vector<std::unique_ptr<Slot[]>> _chunks;
+    int _count = 0;
+
+    static constexpr int _chunkSize = 4096;             //videos per chunk
 };
 
 #endif // VIDEO_H
@@ -1,7 +1,7 @@
 TARGET = Vidupe
 TEMPLATE = app
 
-QT += core gui widgets sql
+QT += core gui widgets sql network
 
 #QMAKE_LFLAGS += -Wl,--large-address-aware
 QMAKE_CXXFLAGS_RELEASE -= -O
@@ -19,14 +19,34 @@ HEADERS += \
     video.h \
     thumbnail.h \
     db.h \
-    comparison.h
+    comparison.h \
+    temporal.h \
+    audiofingerprint.h \
+    prefetcher.h \
+    hashindex.h \
+    scoring.h \
+    tiles.h \
+    metrics.h \
+    snapshot.h \
+    distributed.h \
+    capturecodec.h
 
 SOURCES += \
     mainwindow.cpp \
     video.cpp \
     db.cpp \
     comparison.cpp \
-    ssim.cpp
+    ssim.cpp \
+    temporal.cpp \
+    audiofingerprint.cpp \
+    prefetcher.cpp \
+    hashindex.cpp \
+    scoring.cpp \
+    tiles.cpp \
+    metrics.cpp \
+    snapshot.cpp \
+    distributed.cpp \
+    capturecodec.cpp
 
 FORMS += \
     mainwindow.ui \
@@ -75,3 +95,5 @@ DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
     #ffmpeg.exe must be in same folder where Vidupe.exe is generated (or any folder in %PATH%)
 
     #extensions.ini must be in folder where Vidupe.exe is generated (\build-Vidupe-Desktop_Qt_5___MinGW_32bit-Debug\debug)
+
+    #benchmark/benchmark.pro builds a console program that measures speed of comparison kernels (pHash, SSIM, hamming)